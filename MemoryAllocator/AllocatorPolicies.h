@@ -0,0 +1,56 @@
+#pragma once
+#include "ArenaLock.h"
+#include <cstdint>
+
+// Lock and statistics policies for BasicMemoryAllocator configurations. The null
+// policies keep the interface of the real ones, so the arena code is the same either
+// way and the compiler drops every call.
+
+// Lock for arenas that never leave one thread. Whatever policy the options ask for,
+// nothing is locked or counted.
+class NullLock
+{
+public:
+
+	explicit NullLock(LockingPolicy) {}
+	NullLock(const NullLock&) = delete;
+	NullLock& operator=(const NullLock&) = delete;
+
+	void lock() {}
+	bool try_lock() { return true; }
+	void unlock() {}
+
+	LockingPolicy policy() const { return LockingPolicy::None; }
+	std::uint64_t acquires() const { return 0; }
+	std::uint64_t contentions() const { return 0; }
+};
+
+// Counter that ignores every update and always reads 0.
+struct null_counter
+{
+	null_counter() {}
+	null_counter(std::uint64_t) {}
+
+	null_counter& operator++() { return *this; }
+	null_counter& operator--() { return *this; }
+	null_counter operator++(int) { return *this; }
+	null_counter operator--(int) { return *this; }
+	null_counter& operator+=(std::uint64_t) { return *this; }
+	null_counter& operator-=(std::uint64_t) { return *this; }
+
+	operator std::uint64_t() const { return 0; }
+};
+
+// Keeps the occupancy counters behind getFreeCells and friends, checked by verifyHeap.
+struct CountingStats
+{
+	typedef std::uint64_t counter;
+	static const bool enabled = true;
+};
+
+// Drops the occupancy counters; the getters return 0 and verifyHeap skips them.
+struct NullStats
+{
+	typedef null_counter counter;
+	static const bool enabled = false;
+};
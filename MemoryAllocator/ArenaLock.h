@@ -0,0 +1,92 @@
+#pragma once
+#include "SpinLock.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+enum class LockingPolicy
+{
+	// No locking; the arena must stay on one thread at a time.
+	None,
+	Spin,
+	Mutex
+};
+
+// Lock behind every public MemoryAllocator call, chosen at construction. Counts
+// how often it was taken and how often a caller found it already held.
+class ArenaLock
+{
+public:
+
+	explicit ArenaLock(LockingPolicy policy) : m_policy(policy), m_acquires(0), m_contentions(0) {}
+	ArenaLock(const ArenaLock&) = delete;
+	ArenaLock& operator=(const ArenaLock&) = delete;
+
+	void lock()
+	{
+		if (try_lock())
+		{
+			return;
+		}
+
+		if (m_policy == LockingPolicy::Spin)
+		{
+			m_spinLock.lock();
+		}
+		else
+		{
+			m_mutex.lock();
+		}
+
+		counted();
+	}
+
+	// Fails without waiting, and counts a contention, when another thread holds the lock.
+	bool try_lock()
+	{
+		if (m_policy == LockingPolicy::None)
+		{
+			return true;
+		}
+
+		bool locked = m_policy == LockingPolicy::Spin ? m_spinLock.try_lock() : m_mutex.try_lock();
+
+		if (!locked)
+		{
+			m_contentions.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		counted();
+		return true;
+	}
+
+	void unlock()
+	{
+		if (m_policy == LockingPolicy::Spin)
+		{
+			m_spinLock.unlock();
+		}
+		else if (m_policy == LockingPolicy::Mutex)
+		{
+			m_mutex.unlock();
+		}
+	}
+
+	LockingPolicy policy() const { return m_policy; }
+	std::uint64_t acquires() const { return m_acquires.load(std::memory_order_relaxed); }
+	std::uint64_t contentions() const { return m_contentions.load(std::memory_order_relaxed); }
+
+private:
+	LockingPolicy m_policy;
+	SpinLock m_spinLock;
+	std::mutex m_mutex;
+	std::atomic<std::uint64_t> m_acquires;
+	std::atomic<std::uint64_t> m_contentions;
+
+	// Only the holder writes the acquire count, so it needs no read-modify-write.
+	void counted()
+	{
+		m_acquires.store(m_acquires.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+};
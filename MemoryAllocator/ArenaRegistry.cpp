@@ -0,0 +1,28 @@
+#include "ArenaRegistry.h"
+
+static std::atomic<arena_record*> s_arenas[MAX_ARENA_COUNT];
+
+int registerArena(arena_record* record)
+{
+	for (int id = 1; id < MAX_ARENA_COUNT; id++)
+	{
+		arena_record* empty = nullptr;
+
+		if (!s_arenas[id].load(std::memory_order_relaxed) && s_arenas[id].compare_exchange_strong(empty, record))
+		{
+			return id;
+		}
+	}
+
+	return 0;
+}
+
+void unregisterArena(int id)
+{
+	s_arenas[id].store(nullptr, std::memory_order_release);
+}
+
+arena_record* registeredArena(int id)
+{
+	return id ? s_arenas[id].load(std::memory_order_acquire) : nullptr;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "MemoryAllocator.h"
+
+// Live arenas of every configuration by id. Used blocks carry their arena's id in the
+// tag, so any thread can find the owner of a block. Slot 0 stays empty so that
+// untagged blocks have no owner.
+
+// Claims a free id for the record; 0 when every id is taken.
+int registerArena(arena_record*);
+void unregisterArena(int id);
+arena_record* registeredArena(int id);
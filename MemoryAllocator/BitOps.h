@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit. The mask must not be zero.
+inline int findLowestBit(std::uint64_t mask)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+#if defined(_WIN64)
+	_BitScanForward64(&index, mask);
+	return static_cast<int>(index);
+#else
+	if (_BitScanForward(&index, static_cast<unsigned long>(mask)))
+	{
+		return static_cast<int>(index);
+	}
+
+	_BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+	return static_cast<int>(index) + 32;
+#endif
+#else
+	return __builtin_ctzll(mask);
+#endif
+}
+
+// Index of the highest set bit. The mask must not be zero.
+inline int findHighestBit(std::uint64_t mask)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+#if defined(_WIN64)
+	_BitScanReverse64(&index, mask);
+	return static_cast<int>(index);
+#else
+	if (_BitScanReverse(&index, static_cast<unsigned long>(mask >> 32)))
+	{
+		return static_cast<int>(index) + 32;
+	}
+
+	_BitScanReverse(&index, static_cast<unsigned long>(mask));
+	return static_cast<int>(index);
+#endif
+#else
+	return 63 - __builtin_clzll(mask);
+#endif
+}
@@ -0,0 +1,466 @@
+#include "BuddyHeap.h"
+#include "BitOps.h"
+#include "PageSource.h"
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <new>
+
+const unsigned char BUDDY_FREE_BIT = 0x80;
+const unsigned char BUDDY_ORDER_MASK = 0x7f;
+// Heap regions are aligned this far, so any block of at least this size is too.
+const size_type BUDDY_HEAP_ALIGNMENT = 4096;
+
+static int orderFor(size_type n)
+{
+	if (n <= BUDDY_MIN_BLOCK)
+	{
+		return BUDDY_MIN_ORDER;
+	}
+
+	return findHighestBit(n - 1) + 1;
+}
+
+static unsigned char& orderEntry(const buddy_region* region, size_type offset)
+{
+	return region->orders[offset >> BUDDY_MIN_ORDER];
+}
+
+static bool baseLess(const buddy_region* region, const char* address)
+{
+	return std::less<const char*>()(region->base, address);
+}
+
+BuddyHeap::BuddyHeap(const MemoryAllocatorOptions& options)
+	: m_options(options), m_nonEmptyOrders(0), m_freeRegionCount(0),
+	m_freeBlocks(0), m_usedBlocks(0), m_freeBytes(0), m_usedBytes(0), m_reservedBytes(0)
+{
+	m_baseAlignment = m_options.backing == ArenaBacking::Mapped ? HUGE_PAGE_SIZE : BUDDY_HEAP_ALIGNMENT;
+
+	for (int i = 0; i < SIZE_CLASS_COUNT; i++)
+	{
+		m_freeLists[i] = nullptr;
+	}
+
+	// Like the boundary-tag engine, the first region is acquired up front and retained.
+	addRegion(0);
+}
+
+BuddyHeap::~BuddyHeap()
+{
+	while (!m_regions.empty())
+	{
+		releaseRegion(m_regions.back());
+	}
+}
+
+void* BuddyHeap::allocate(size_type n, size_type alignment)
+{
+	if (n > (size_type(1) << (sizeof(size_type) * 8 - 2)) || alignment > m_baseAlignment)
+	{
+		return nullptr;
+	}
+
+	// Blocks are aligned to their own size within the region.
+	int order = orderFor(n > alignment ? n : alignment);
+	std::uint64_t orders = m_nonEmptyOrders & (~std::uint64_t(0) << order);
+	buddy_node* block;
+	int blockOrder;
+
+	if (orders)
+	{
+		blockOrder = findLowestBit(orders);
+		block = m_freeLists[blockOrder];
+	}
+	else
+	{
+		block = addRegion(order);
+
+		if (!block)
+		{
+			return nullptr;
+		}
+
+		blockOrder = block->region->maxOrder;
+	}
+
+	buddy_region* region = block->region;
+	size_type offset = reinterpret_cast<char*>(block) - region->base;
+
+	removeFree(block, blockOrder);
+
+	if (blockOrder == region->maxOrder)
+	{
+		m_freeRegionCount--;
+	}
+
+	// The upper halves split off on the way down stay free.
+	while (blockOrder > order)
+	{
+		blockOrder--;
+		addFree(region, offset + (size_type(1) << blockOrder), blockOrder);
+	}
+
+	orderEntry(region, offset) = static_cast<unsigned char>(order);
+	m_usedBlocks++;
+	m_usedBytes += size_type(1) << order;
+
+	return block;
+}
+
+bool BuddyHeap::owns(const void* pointer) const
+{
+	return regionOf(pointer) != nullptr;
+}
+
+void BuddyHeap::deallocate(void* pointer)
+{
+	buddy_region* region = regionOf(pointer);
+	assert(region && "block does not belong to this buddy heap");
+	size_type offset = static_cast<char*>(pointer) - region->base;
+	int order = orderEntry(region, offset) & BUDDY_ORDER_MASK;
+
+	m_usedBlocks--;
+	m_usedBytes -= size_type(1) << order;
+
+	// Merge upwards for as long as the buddy is a whole free block of the same order.
+	while (order < region->maxOrder)
+	{
+		size_type buddy = offset ^ (size_type(1) << order);
+
+		if (orderEntry(region, buddy) != (BUDDY_FREE_BIT | order))
+		{
+			break;
+		}
+
+		removeFree(reinterpret_cast<buddy_node*>(region->base + buddy), order);
+		offset &= ~(size_type(1) << order);
+		order++;
+	}
+
+	if (order == region->maxOrder)
+	{
+		if (m_freeRegionCount >= m_options.retainedFreeChunks)
+		{
+			releaseRegion(region);
+			return;
+		}
+
+		m_freeRegionCount++;
+	}
+
+	addFree(region, offset, order);
+}
+
+bool BuddyHeap::tryExpand(void* pointer, size_type n)
+{
+	buddy_region* region = regionOf(pointer);
+	assert(region && "block does not belong to this buddy heap");
+	size_type offset = static_cast<char*>(pointer) - region->base;
+	int order = orderEntry(region, offset) & BUDDY_ORDER_MASK;
+	int wanted = orderFor(n);
+
+	if (wanted > region->maxOrder)
+	{
+		return false;
+	}
+
+	// Every buddy on the way up must be a free right buddy, so all are checked before any is taken.
+	for (int i = order; i < wanted; i++)
+	{
+		size_type buddy = offset + (size_type(1) << i);
+
+		if ((offset & (size_type(1) << i)) || orderEntry(region, buddy) != (BUDDY_FREE_BIT | i))
+		{
+			return false;
+		}
+	}
+
+	m_usedBytes -= size_type(1) << order;
+
+	for (; order < wanted; order++)
+	{
+		removeFree(reinterpret_cast<buddy_node*>(region->base + offset + (size_type(1) << order)), order);
+	}
+
+	while (order > wanted)
+	{
+		order--;
+		addFree(region, offset + (size_type(1) << order), order);
+	}
+
+	orderEntry(region, offset) = static_cast<unsigned char>(order);
+	m_usedBytes += size_type(1) << order;
+
+	return true;
+}
+
+size_type BuddyHeap::usableSize(const void* pointer) const
+{
+	const buddy_region* region = regionOf(pointer);
+	assert(region && "block does not belong to this buddy heap");
+
+	return size_type(1) << (orderEntry(region, static_cast<const char*>(pointer) - region->base) & BUDDY_ORDER_MASK);
+}
+
+buddy_node* BuddyHeap::addRegion(int order)
+{
+	size_type size = m_options.chunkSize;
+
+	if (size < (size_type(1) << order))
+	{
+		size = size_type(1) << order;
+	}
+
+	int maxOrder = orderFor(size);
+	size = size_type(1) << maxOrder;
+
+	if (m_options.maxArenaSize && m_reservedBytes + size > m_options.maxArenaSize)
+	{
+		return nullptr;
+	}
+
+	buddy_region* region = new (std::nothrow) buddy_region();
+
+	if (!region)
+	{
+		return nullptr;
+	}
+
+	region->orders = new (std::nothrow) unsigned char[size >> BUDDY_MIN_ORDER];
+
+	if (!region->orders)
+	{
+		delete region;
+		return nullptr;
+	}
+
+	if (m_options.backing == ArenaBacking::Mapped)
+	{
+		region->memory = mapPages(size, HUGE_PAGE_SIZE, m_options.hugePages);
+		region->base = static_cast<char*>(region->memory);
+	}
+	else
+	{
+		region->memory = new (std::nothrow) char[size + BUDDY_HEAP_ALIGNMENT];
+		region->base = reinterpret_cast<char*>(
+			(reinterpret_cast<size_type>(region->memory) + BUDDY_HEAP_ALIGNMENT - 1) & ~(BUDDY_HEAP_ALIGNMENT - 1));
+	}
+
+	if (!region->memory)
+	{
+		delete [] region->orders;
+		delete region;
+		return nullptr;
+	}
+
+	region->size = size;
+	region->maxOrder = maxOrder;
+
+	m_regions.insert(std::lower_bound(m_regions.begin(), m_regions.end(), region->base, baseLess), region);
+	m_reservedBytes += size;
+	m_freeRegionCount++;
+
+	addFree(region, 0, maxOrder);
+
+	return reinterpret_cast<buddy_node*>(region->base);
+}
+
+void BuddyHeap::releaseRegion(buddy_region* region)
+{
+	// A released region is always one whole free block.
+	if (orderEntry(region, 0) == (BUDDY_FREE_BIT | region->maxOrder))
+	{
+		removeFree(reinterpret_cast<buddy_node*>(region->base), region->maxOrder);
+		m_freeRegionCount--;
+	}
+
+	m_regions.erase(std::lower_bound(m_regions.begin(), m_regions.end(), region->base, baseLess));
+	m_reservedBytes -= region->size;
+
+	if (m_options.backing == ArenaBacking::Mapped)
+	{
+		unmapPages(region->memory, region->size);
+	}
+	else
+	{
+		delete [] static_cast<char*>(region->memory);
+	}
+
+	delete [] region->orders;
+	delete region;
+}
+
+buddy_region* BuddyHeap::regionOf(const void* pointer) const
+{
+	const char* address = static_cast<const char*>(pointer);
+
+	// The last region starting at or before the address.
+	std::vector<buddy_region*>::const_iterator next = std::upper_bound(m_regions.begin(), m_regions.end(), address,
+		[](const char* value, const buddy_region* region) { return std::less<const char*>()(value, region->base); });
+
+	if (next == m_regions.begin())
+	{
+		return nullptr;
+	}
+
+	buddy_region* region = *(next - 1);
+
+	return std::less<const char*>()(address, region->base + region->size) ? region : nullptr;
+}
+
+void BuddyHeap::addFree(buddy_region* region, size_type offset, int order)
+{
+	buddy_node* freed = reinterpret_cast<buddy_node*>(region->base + offset);
+
+	freed->region = region;
+	freed->previous = nullptr;
+	freed->next = m_freeLists[order];
+
+	if (freed->next)
+	{
+		freed->next->previous = freed;
+	}
+
+	m_freeLists[order] = freed;
+	m_nonEmptyOrders |= std::uint64_t(1) << order;
+	orderEntry(region, offset) = static_cast<unsigned char>(BUDDY_FREE_BIT | order);
+
+	m_freeBlocks++;
+	m_freeBytes += size_type(1) << order;
+}
+
+void BuddyHeap::removeFree(buddy_node* used, int order)
+{
+	if (used->previous)
+	{
+		used->previous->next = used->next;
+	}
+	else
+	{
+		m_freeLists[order] = used->next;
+
+		if (!used->next)
+		{
+			m_nonEmptyOrders &= ~(std::uint64_t(1) << order);
+		}
+	}
+
+	if (used->next)
+	{
+		used->next->previous = used->previous;
+	}
+
+	// Cleared so a stale free entry can never be mistaken for a free buddy.
+	orderEntry(used->region, reinterpret_cast<char*>(used) - used->region->base) = static_cast<unsigned char>(order);
+
+	m_freeBlocks--;
+	m_freeBytes -= size_type(1) << order;
+}
+
+bool BuddyHeap::verify(const char*& message, const void*& address) const
+{
+	std::uint64_t freeBlocks = 0;
+	std::uint64_t usedBlocks = 0;
+	std::uint64_t freeBytes = 0;
+	std::uint64_t usedBytes = 0;
+	size_type freeRegions = 0;
+
+	for (size_t i = 0; i < m_regions.size(); i++)
+	{
+		const buddy_region* region = m_regions[i];
+		size_type offset = 0;
+
+		if (i && !std::less<const char*>()(m_regions[i - 1]->base, region->base))
+		{
+			message = "buddy regions are out of order";
+			address = region->base;
+			return false;
+		}
+
+		while (offset < region->size)
+		{
+			unsigned char entry = orderEntry(region, offset);
+			int order = entry & BUDDY_ORDER_MASK;
+			size_type size = size_type(1) << order;
+
+			address = region->base + offset;
+
+			if (order < BUDDY_MIN_ORDER || order > region->maxOrder || (offset & (size - 1)))
+			{
+				message = "buddy block order does not fit its offset";
+				return false;
+			}
+
+			if (entry & BUDDY_FREE_BIT)
+			{
+				if (order < region->maxOrder && orderEntry(region, offset ^ size) == entry)
+				{
+					message = "two free buddies were not merged";
+					return false;
+				}
+
+				freeBlocks++;
+				freeBytes += size;
+				freeRegions += order == region->maxOrder;
+			}
+			else
+			{
+				usedBlocks++;
+				usedBytes += size;
+			}
+
+			offset += size;
+		}
+	}
+
+	std::uint64_t listedBlocks = 0;
+
+	for (int order = 0; order < SIZE_CLASS_COUNT; order++)
+	{
+		if (!m_freeLists[order] != !(m_nonEmptyOrders & (std::uint64_t(1) << order)))
+		{
+			message = "buddy order bitmap disagrees with its free list";
+			address = &m_freeLists[order];
+			return false;
+		}
+
+		const buddy_node* previous = nullptr;
+
+		for (const buddy_node* current = m_freeLists[order]; current; previous = current, current = current->next)
+		{
+			address = current;
+
+			if (current->previous != previous)
+			{
+				message = "buddy free list back link is broken";
+				return false;
+			}
+
+			if (orderEntry(current->region, reinterpret_cast<const char*>(current) - current->region->base) != (BUDDY_FREE_BIT | order))
+			{
+				message = "buddy free list holds a block of another order";
+				return false;
+			}
+
+			listedBlocks++;
+		}
+	}
+
+	address = nullptr;
+
+	if (listedBlocks != freeBlocks)
+	{
+		message = "buddy free lists and regions disagree on the number of free blocks";
+		return false;
+	}
+
+	if (freeBlocks != m_freeBlocks || usedBlocks != m_usedBlocks || freeBytes != m_freeBytes ||
+		usedBytes != m_usedBytes || freeRegions != m_freeRegionCount)
+	{
+		message = "buddy counters do not match the regions";
+		return false;
+	}
+
+	return true;
+}
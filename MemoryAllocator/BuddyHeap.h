@@ -0,0 +1,84 @@
+#pragma once
+#include "MemoryAllocator.h"
+#include <vector>
+
+// Smallest buddy block; the order table keeps one byte per block of this size.
+const int BUDDY_MIN_ORDER = 6;
+const size_type BUDDY_MIN_BLOCK = size_type(1) << BUDDY_MIN_ORDER;
+
+// One power-of-two region acquired from the backing store. Blocks are addressed by
+// their offset from base, so a block's buddy is offset ^ block size.
+struct buddy_region
+{
+	char* base;
+	// What the backing store handed out; heap regions are aligned up from it.
+	void* memory;
+	size_type size;
+	int maxOrder;
+	// Order of the block starting at each BUDDY_MIN_BLOCK offset, with BUDDY_FREE_BIT
+	// set on free blocks. Entries inside a block are stale and never read.
+	unsigned char* orders;
+};
+
+struct buddy_node
+{
+	buddy_node* previous;
+	buddy_node* next;
+	buddy_region* region;
+};
+
+// Binary buddy back end behind MemoryAllocator's AllocationEngine::Buddy. Blocks are
+// powers of two with no header, kept in one free list per order with a bitmap of
+// non-empty orders, so allocation is a bit scan plus splits and freeing is a chain of
+// XOR buddy lookups.
+class BuddyHeap
+{
+public:
+
+	explicit BuddyHeap(const MemoryAllocatorOptions&);
+	BuddyHeap(const BuddyHeap&) = delete;
+	BuddyHeap& operator=(const BuddyHeap&) = delete;
+	~BuddyHeap();
+
+	// Alignment must be a power of two no larger than the region base alignment.
+	void* allocate(size_type, size_type alignment);
+	// True when the address lies in one of this heap's regions. deallocate, tryExpand
+	// and usableSize only take such blocks.
+	bool owns(const void*) const;
+	void deallocate(void*);
+	// Shrinking frees the upper halves; growing absorbs free right buddies.
+	bool tryExpand(void*, size_type);
+	size_type usableSize(const void*) const;
+
+	std::uint64_t getFreeBlocks() const { return m_freeBlocks; }
+	std::uint64_t getUsedBlocks() const { return m_usedBlocks; }
+	std::uint64_t getFreeBytes() const { return m_freeBytes; }
+	std::uint64_t getUsedBytes() const { return m_usedBytes; }
+	int getRegionCount() const { return static_cast<int>(m_regions.size()); }
+	size_type getReservedBytes() const { return m_reservedBytes; }
+
+	// Checks the order tables against the free lists and counters. On failure the
+	// problem and its address are returned through the arguments.
+	bool verify(const char*& message, const void*& address) const;
+
+private:
+	MemoryAllocatorOptions m_options;
+	// Sorted by base, for finding the region of a pointer.
+	std::vector<buddy_region*> m_regions;
+	buddy_node* m_freeLists[SIZE_CLASS_COUNT];
+	std::uint64_t m_nonEmptyOrders;
+	size_type m_baseAlignment;
+	size_type m_freeRegionCount;
+	std::uint64_t m_freeBlocks;
+	std::uint64_t m_usedBlocks;
+	std::uint64_t m_freeBytes;
+	std::uint64_t m_usedBytes;
+	size_type m_reservedBytes;
+
+	buddy_node* addRegion(int order);
+	void releaseRegion(buddy_region*);
+	buddy_region* regionOf(const void*) const;
+
+	void addFree(buddy_region*, size_type offset, int order);
+	void removeFree(buddy_node*, int order);
+};
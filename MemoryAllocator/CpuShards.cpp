@@ -0,0 +1,154 @@
+#include "CpuShards.h"
+#include "SpinLock.h"
+#include <mutex>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#if defined(__has_include)
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#define MEMORY_ALLOCATOR_HAS_RSEQ 1
+#endif
+#endif
+#endif
+
+struct cpu_shard
+{
+	explicit cpu_shard(const MemoryAllocatorOptions& options) : arena(options) {}
+
+	SpinLock lock;
+	MemoryAllocator arena;
+};
+
+int currentCpu()
+{
+#if defined(_WIN32)
+	return static_cast<int>(GetCurrentProcessorNumber());
+#elif defined(__linux__)
+#if defined(MEMORY_ALLOCATOR_HAS_RSEQ)
+	// The kernel keeps cpu_id current on every return to user space, so this is one load.
+	if (__rseq_size)
+	{
+		const volatile struct rseq* area = reinterpret_cast<const struct rseq*>(
+			static_cast<const char*>(__builtin_thread_pointer()) + __rseq_offset);
+		int cpu = static_cast<int>(area->cpu_id);
+
+		if (cpu >= 0)
+		{
+			return cpu;
+		}
+	}
+#endif
+	int cpu = sched_getcpu();
+	return cpu < 0 ? 0 : cpu;
+#else
+	return 0;
+#endif
+}
+
+static int defaultShardCount()
+{
+	unsigned int cores = std::thread::hardware_concurrency();
+	return cores ? static_cast<int>(cores) : 1;
+}
+
+CpuShardedAllocator::CpuShardedAllocator() : CpuShardedAllocator(defaultShardCount())
+{}
+
+CpuShardedAllocator::CpuShardedAllocator(int shardCount, const MemoryAllocatorOptions& options)
+{
+	if (shardCount < 1)
+	{
+		shardCount = 1;
+	}
+
+	for (int i = 0; i < shardCount; i++)
+	{
+		m_shards.push_back(std::unique_ptr<cpu_shard>(new cpu_shard(MemoryAllocatorOptions::tagged(options))));
+	}
+}
+
+CpuShardedAllocator::~CpuShardedAllocator()
+{}
+
+void* CpuShardedAllocator::allocate(size_type n)
+{
+	cpu_shard& current = currentShard();
+	std::lock_guard<SpinLock> guard(current.lock);
+
+	return current.arena.allocate(n);
+}
+
+void CpuShardedAllocator::deallocate(void* pointer)
+{
+	// Blocks of other shards are pushed onto their owner's stack without taking its lock.
+	cpu_shard& current = currentShard();
+	std::lock_guard<SpinLock> guard(current.lock);
+
+	current.arena.deallocate(pointer);
+}
+
+int CpuShardedAllocator::getShardCount() const
+{
+	return static_cast<int>(m_shards.size());
+}
+
+std::uint64_t CpuShardedAllocator::getFreeCells() const
+{
+	return totals().freeCells;
+}
+
+std::uint64_t CpuShardedAllocator::getUsedCells() const
+{
+	return totals().usedCells;
+}
+
+std::uint64_t CpuShardedAllocator::getUsedAmount() const
+{
+	return totals().usedAmount;
+}
+
+std::uint64_t CpuShardedAllocator::getFreeAmount() const
+{
+	return totals().freeAmount;
+}
+
+size_type CpuShardedAllocator::getReservedBytes() const
+{
+	return totals().reservedBytes;
+}
+
+size_type CpuShardedAllocator::getCommittedBytes() const
+{
+	return totals().committedBytes;
+}
+
+cpu_shard& CpuShardedAllocator::currentShard() const
+{
+	return *m_shards[currentCpu() % m_shards.size()];
+}
+
+CpuShardedAllocator::shard_totals CpuShardedAllocator::totals() const
+{
+	shard_totals result = {};
+
+	for (size_t i = 0; i < m_shards.size(); i++)
+	{
+		std::lock_guard<SpinLock> guard(m_shards[i]->lock);
+		MemoryAllocator& arena = m_shards[i]->arena;
+
+		arena.drainRemoteFrees();
+
+		result.freeCells += arena.getFreeCells();
+		result.usedCells += arena.getUsedCells();
+		result.usedAmount += arena.getUsedAmount();
+		result.freeAmount += arena.getFreeAmount();
+		result.reservedBytes += arena.getReservedBytes();
+		result.committedBytes += arena.getCommittedBytes();
+	}
+
+	return result;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "MemoryAllocator.h"
+#include <memory>
+#include <vector>
+
+// Processor the calling thread runs on right now. On Linux it is read from the
+// restartable sequences area glibc registers for every thread, with sched_getcpu
+// as the fallback. The thread may migrate right after, so this is only a hint.
+int currentCpu();
+
+struct cpu_shard;
+
+// Thread-safe front end holding one MemoryAllocator per shard, picked by the current
+// CPU, so memory grows with the core count rather than the thread count. Each shard
+// sits behind a spin lock, held only for one arena call. Blocks freed on another CPU
+// go onto their own shard's remote free stack and are reclaimed by that shard.
+class CpuShardedAllocator
+{
+public:
+
+	// One shard per hardware thread.
+	CpuShardedAllocator();
+	// Frees find their shard through the block tag, so the Buddy engine is replaced by SegregatedFit.
+	explicit CpuShardedAllocator(int shardCount, const MemoryAllocatorOptions& = MemoryAllocatorOptions());
+	CpuShardedAllocator(const CpuShardedAllocator&) = delete;
+	CpuShardedAllocator& operator=(const CpuShardedAllocator&) = delete;
+	~CpuShardedAllocator();
+
+	void* allocate(size_type);
+	void deallocate(void*);
+
+	int getShardCount() const;
+
+	// Totals over all shards. Each shard reclaims its pending remote frees first.
+	std::uint64_t getFreeCells() const;
+	std::uint64_t getUsedCells() const;
+	std::uint64_t getUsedAmount() const;
+	std::uint64_t getFreeAmount() const;
+	size_type getReservedBytes() const;
+	size_type getCommittedBytes() const;
+
+private:
+	struct shard_totals
+	{
+		std::uint64_t freeCells;
+		std::uint64_t usedCells;
+		std::uint64_t usedAmount;
+		std::uint64_t freeAmount;
+		size_type reservedBytes;
+		size_type committedBytes;
+	};
+
+	std::vector<std::unique_ptr<cpu_shard>> m_shards;
+
+	cpu_shard& currentShard() const;
+	shard_totals totals() const;
+};
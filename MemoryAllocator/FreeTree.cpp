@@ -0,0 +1,249 @@
+#include "FreeTree.h"
+#include <functional>
+
+static size_type blockSizeOf(const tree_node* treeNode)
+{
+	return (reinterpret_cast<const info_header*>(treeNode) - 1)->size();
+}
+
+static bool keyLess(const tree_node* left, const tree_node* right)
+{
+	size_type leftSize = blockSizeOf(left);
+	size_type rightSize = blockSizeOf(right);
+
+	return leftSize < rightSize || (leftSize == rightSize && std::less<const tree_node*>()(left, right));
+}
+
+static int height(const tree_node* treeNode)
+{
+	return treeNode ? treeNode->height : 0;
+}
+
+static void updateHeight(tree_node* treeNode)
+{
+	int left = height(treeNode->left);
+	int right = height(treeNode->right);
+
+	treeNode->height = 1 + (left > right ? left : right);
+}
+
+static void replaceChild(tree_node*& root, tree_node* parent, tree_node* oldChild, tree_node* newChild)
+{
+	if (!parent)
+	{
+		root = newChild;
+	}
+	else if (parent->left == oldChild)
+	{
+		parent->left = newChild;
+	}
+	else
+	{
+		parent->right = newChild;
+	}
+
+	if (newChild)
+	{
+		newChild->parent = parent;
+	}
+}
+
+static tree_node* rotateLeft(tree_node*& root, tree_node* top)
+{
+	tree_node* pivot = top->right;
+
+	top->right = pivot->left;
+
+	if (pivot->left)
+	{
+		pivot->left->parent = top;
+	}
+
+	replaceChild(root, top->parent, top, pivot);
+	pivot->left = top;
+	top->parent = pivot;
+
+	updateHeight(top);
+	updateHeight(pivot);
+
+	return pivot;
+}
+
+static tree_node* rotateRight(tree_node*& root, tree_node* top)
+{
+	tree_node* pivot = top->left;
+
+	top->left = pivot->right;
+
+	if (pivot->right)
+	{
+		pivot->right->parent = top;
+	}
+
+	replaceChild(root, top->parent, top, pivot);
+	pivot->right = top;
+	top->parent = pivot;
+
+	updateHeight(top);
+	updateHeight(pivot);
+
+	return pivot;
+}
+
+// Restores heights and balance from treeNode up to the root.
+static void retrace(tree_node*& root, tree_node* treeNode)
+{
+	while (treeNode)
+	{
+		updateHeight(treeNode);
+		int balance = height(treeNode->left) - height(treeNode->right);
+
+		if (balance > 1)
+		{
+			if (height(treeNode->left->left) < height(treeNode->left->right))
+			{
+				rotateLeft(root, treeNode->left);
+			}
+
+			treeNode = rotateRight(root, treeNode);
+		}
+		else if (balance < -1)
+		{
+			if (height(treeNode->right->right) < height(treeNode->right->left))
+			{
+				rotateRight(root, treeNode->right);
+			}
+
+			treeNode = rotateLeft(root, treeNode);
+		}
+
+		treeNode = treeNode->parent;
+	}
+}
+
+void treeInsert(tree_node*& root, tree_node* inserted)
+{
+	tree_node* parent = nullptr;
+	tree_node** link = &root;
+
+	while (*link)
+	{
+		parent = *link;
+		link = keyLess(inserted, parent) ? &parent->left : &parent->right;
+	}
+
+	inserted->left = nullptr;
+	inserted->right = nullptr;
+	inserted->parent = parent;
+	inserted->height = 1;
+	*link = inserted;
+
+	retrace(root, parent);
+}
+
+void treeRemove(tree_node*& root, tree_node* removed)
+{
+	if (removed->left && removed->right)
+	{
+		// The nodes cannot be copied, so the successor itself moves into the removed node's place.
+		tree_node* successor = removed->right;
+		tree_node* retraceFrom = successor;
+
+		while (successor->left)
+		{
+			successor = successor->left;
+		}
+
+		if (successor->parent != removed)
+		{
+			retraceFrom = successor->parent;
+			replaceChild(root, successor->parent, successor, successor->right);
+			successor->right = removed->right;
+			successor->right->parent = successor;
+		}
+
+		successor->left = removed->left;
+		successor->left->parent = successor;
+		successor->height = removed->height;
+		replaceChild(root, removed->parent, removed, successor);
+
+		retrace(root, retraceFrom);
+	}
+	else
+	{
+		tree_node* parent = removed->parent;
+
+		replaceChild(root, parent, removed, removed->left ? removed->left : removed->right);
+		retrace(root, parent);
+	}
+}
+
+tree_node* treeFindFit(tree_node* root, size_type n)
+{
+	tree_node* best = nullptr;
+
+	while (root)
+	{
+		if (blockSizeOf(root) >= n)
+		{
+			best = root;
+			root = root->left;
+		}
+		else
+		{
+			root = root->right;
+		}
+	}
+
+	return best;
+}
+
+// Every node must sort strictly between the bounds its ancestors set.
+static bool verifyRange(const tree_node* root, const tree_node* lower, const tree_node* upper,
+	size_type minSize, std::uint64_t& count, const tree_node*& bad)
+{
+	if (!root)
+	{
+		return true;
+	}
+
+	const info_header* header = reinterpret_cast<const info_header*>(root) - 1;
+
+	bad = root;
+
+	if (!header->isFree() || header->size() < minSize)
+	{
+		return false;
+	}
+
+	if ((lower && !keyLess(lower, root)) || (upper && !keyLess(root, upper)) ||
+		(root->left && root->left->parent != root) || (root->right && root->right->parent != root))
+	{
+		return false;
+	}
+
+	int left = height(root->left);
+	int right = height(root->right);
+
+	if (root->height != 1 + (left > right ? left : right) || left - right > 1 || right - left > 1)
+	{
+		return false;
+	}
+
+	count++;
+
+	return verifyRange(root->left, lower, root, minSize, count, bad) &&
+		verifyRange(root->right, root, upper, minSize, count, bad);
+}
+
+bool treeVerify(const tree_node* root, size_type minSize, std::uint64_t& count, const tree_node*& bad)
+{
+	// An empty threshold means the tree is not in use and must stay empty.
+	if (root && (root->parent || !minSize))
+	{
+		bad = root;
+		return false;
+	}
+
+	return verifyRange(root, nullptr, nullptr, minSize, count, bad);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "MemoryAllocator.h"
+
+// Intrusive AVL tree of free blocks keyed by (block size, address). Nodes live in the
+// payload of the free block, right behind its tag, like the list nodes do.
+
+void treeInsert(tree_node*& root, tree_node*);
+void treeRemove(tree_node*& root, tree_node*);
+// Smallest block of at least n bytes, the lowest addressed one among equal sizes.
+tree_node* treeFindFit(tree_node* root, size_type n);
+
+// Checks ordering, parent links and heights, and that every block is free and at least
+// minSize bytes. Counts the nodes into count; on failure the offending node is returned
+// through bad.
+bool treeVerify(const tree_node* root, size_type minSize, std::uint64_t& count, const tree_node*& bad);
@@ -1,14 +1,136 @@
 #pragma once
+#include "AllocatorPolicies.h"
+#include "ArenaLock.h"
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// When enabled, every allocate and deallocate ends with a full verifyHeap() pass.
+// Defaults to on in debug builds; release builds compile the checks away.
+#if !defined(MEMORY_ALLOCATOR_DEBUG_CHECKS)
+#if defined(_DEBUG)
+#define MEMORY_ALLOCATOR_DEBUG_CHECKS 1
+#else
+#define MEMORY_ALLOCATOR_DEBUG_CHECKS 0
+#endif
+#endif
 
 typedef std::size_t size_type;
 
+// Receives every inconsistency found by MemoryAllocator::verifyHeap, with the
+// address of the offending tag or node.
+typedef void (*VerifyCallback)(const char* message, const void* address, void* context);
+
+// Free blocks are kept in one list per power-of-two size class. The TLSF engine
+// further splits every class linearly into SUB_CLASS_COUNT lists.
+const int SIZE_CLASS_COUNT = 64;
+const int SUB_CLASS_LOG2 = 4;
+const int SUB_CLASS_COUNT = 1 << SUB_CLASS_LOG2;
+
+enum class AllocationEngine
+{
+	// Scans the request's own size class, then takes any block from a larger class.
+	SegregatedFit,
+	// Two-level segregated fit: constant time good fit over the two-level bitmap.
+	Tlsf,
+	// Binary buddy system over power-of-two regions; blocks carry no tag. See BuddyHeap.
+	Buddy
+};
+
+// Search policies of a BasicMemoryAllocator configuration. engine turns the engine the
+// options ask for into the one the arena runs, and tlsf tells the two list searches
+// apart. The fixed policies answer both without looking at their argument, so the
+// other search is never compiled in.
+struct RuntimeSearch
+{
+	static AllocationEngine engine(AllocationEngine requested) { return requested; }
+	static bool tlsf(AllocationEngine engine) { return engine == AllocationEngine::Tlsf; }
+};
+
+struct SegregatedSearch
+{
+	static AllocationEngine engine(AllocationEngine) { return AllocationEngine::SegregatedFit; }
+	static bool tlsf(AllocationEngine) { return false; }
+};
+
+struct TlsfSearch
+{
+	static AllocationEngine engine(AllocationEngine) { return AllocationEngine::Tlsf; }
+	static bool tlsf(AllocationEngine) { return true; }
+};
+
+// Where a freed block goes in its size class list.
+enum class FreeListPolicy
+{
+	// Pushed to the head, so the most recently freed block is reused first.
+	Lifo,
+	// Kept in address order, so every search is a first fit from the low end.
+	AddressOrdered,
+	// Pushed to the head, but searches resume where the last one in the class ended.
+	NextFit
+};
+
+enum class ArenaBacking
+{
+	// Chunks come from operator new[].
+	Heap,
+	// Chunks are mapped straight from the OS, aligned to HUGE_PAGE_SIZE.
+	Mapped
+};
+
+// Flags kept in the low bits of a block tag; block sizes are multiples of
+// ALIGNMENT, so those bits are never part of the size.
+const size_type ALIGNMENT = 16;
+const std::uint64_t FREE_BIT = 1;
+// The block to the left is free, so the word before this header is its footer.
+const std::uint64_t PREV_FREE_BIT = 2;
+// Set on free blocks whose interior pages were given back to the OS.
+const std::uint64_t PURGED_BIT = 4;
+// The block is the first one in its chunk.
+const std::uint64_t FIRST_BIT = 8;
+const std::uint64_t TAG_FLAGS = ALIGNMENT - 1;
+// Used blocks keep the id of the arena that owns them in the top bits of the tag,
+// so a block can be handed back to its owner from any thread.
+const int ARENA_SHIFT = 52;
+const std::uint64_t ARENA_BITS = ~std::uint64_t(0) << ARENA_SHIFT;
+const int MAX_ARENA_COUNT = 1 << (64 - ARENA_SHIFT);
+// Keeps the remote free stack away from the fields only the owner touches.
+const size_type CACHE_LINE_SIZE = 64;
+
+// One 8-byte tag holding the whole block size (tag included) and the flags.
+// Every block starts with one; free blocks repeat it in their last word as a
+// footer, used blocks give that word to the payload.
 struct info_header
 {
-	info_header(bool isFree, size_type amount) : m_isFree(isFree), m_amount(amount) {}
+	std::uint64_t m_tag;
+
+	size_type size() const { return static_cast<size_type>(m_tag & ~(TAG_FLAGS | ARENA_BITS)); }
+	int arena() const { return static_cast<int>(m_tag >> ARENA_SHIFT); }
+	bool isFree() const { return (m_tag & FREE_BIT) != 0; }
+	bool isPrevFree() const { return (m_tag & PREV_FREE_BIT) != 0; }
+	bool isPurged() const { return (m_tag & PURGED_BIT) != 0; }
+	bool isFirst() const { return (m_tag & FIRST_BIT) != 0; }
+
+	// Other threads read the tag of a used block without the owner's lock (see arenaOf
+	// and usableSize) while the owner flips PREV_FREE_BIT in it, so both sides go
+	// through relaxed atomic accesses. Only the owner writes, under its lock.
+	std::uint64_t sharedTag() const { return sharedWord().load(std::memory_order_relaxed); }
 
-	bool m_isFree;
-	size_type m_amount;
+	void setPrevFree(bool prevFree)
+	{
+		std::atomic<std::uint64_t>& tag = const_cast<std::atomic<std::uint64_t>&>(sharedWord());
+		std::uint64_t value = tag.load(std::memory_order_relaxed);
+
+		tag.store(prevFree ? value | PREV_FREE_BIT : value & ~PREV_FREE_BIT, std::memory_order_relaxed);
+	}
+
+private:
+	const std::atomic<std::uint64_t>& sharedWord() const
+	{
+		static_assert(sizeof(std::atomic<std::uint64_t>) == sizeof(std::uint64_t), "tags must be plain words");
+		return reinterpret_cast<const std::atomic<std::uint64_t>&>(m_tag);
+	}
 };
 
 struct node
@@ -17,31 +139,383 @@ struct node
 	node* next;
 };
 
-class MemoryAllocator
+// Free blocks of at least MemoryAllocatorOptions::bestFitThreshold bytes use this
+// instead of a list node. See FreeTree.
+struct tree_node
+{
+	tree_node* left;
+	tree_node* right;
+	tree_node* parent;
+	int height;
+};
+
+// What the arena registry keeps of every live arena. Blocks of any configuration can be
+// pushed onto the remote free stack; the arena itself is only handed out to callers of
+// the same configuration.
+struct arena_record
 {
+	void* arena;
+	const void* config;
+	std::atomic<node*>* remoteFrees;
+};
+
+// Requests of up to MAX_SMALL_SIZE bytes can be served from runs of SMALL_RUN_SIZE
+// bytes, each split into equal slots of one ALIGNMENT multiple.
+const size_type SMALL_RUN_SIZE = 4096;
+const size_type MAX_SMALL_SIZE = 256;
+const int SMALL_CLASS_COUNT = static_cast<int>(MAX_SMALL_SIZE / ALIGNMENT);
+const int SMALL_BITMAP_WORDS = 4;
+
+// Adaptive splitting keeps a histogram of requested block sizes in ALIGNMENT steps;
+// the last bin takes every larger size.
+const int SIZE_HISTOGRAM_BINS = 64;
+
+// Fast bins hold one exact block size each, from ALIGNMENT up to
+// FAST_BIN_COUNT * ALIGNMENT bytes, tags included.
+const int FAST_BIN_COUNT = 32;
+
+// Start of every small-block run. Runs are SMALL_RUN_SIZE aligned, so a slot finds
+// its run by masking its address, and slots carry no tag.
+struct small_run
+{
+	// Set bits are free slots. Kept first so the whole bitmap is one aligned 256-bit load.
+	std::uint64_t freeSlots[SMALL_BITMAP_WORDS];
+	small_run* previous;
+	small_run* next;
+	std::uint32_t slotSize;
+	// ceil(2^32 / slotSize): turns the slot index division into a multiply.
+	std::uint32_t slotReciprocal;
+	std::uint32_t slotCount;
+	std::uint32_t used;
+	std::int32_t arena;
+};
+
+// Start of every chunk acquired from the OS. It is followed by the blocks and a
+// used zero-sized epilogue tag. The first block carries FIRST_BIT and never has
+// PREV_FREE_BIT, so coalescing never crosses a chunk boundary.
+struct chunk
+{
+	chunk* previous;
+	chunk* next;
+	size_type size;
+	// What the backing store handed out; heap chunks are aligned up from it.
+	void* memory;
+};
+
+class BuddyHeap;
+struct coalescer_thread;
+
+struct MemoryAllocatorOptions
+{
+	MemoryAllocatorOptions();
+
+	// Front ends that route frees by block tag cannot run the untagged Buddy engine;
+	// this returns the options with Buddy swapped for SegregatedFit.
+	static MemoryAllocatorOptions tagged(MemoryAllocatorOptions);
+
+	AllocationEngine engine;
+	FreeListPolicy freeListPolicy;
+	// Bytes acquired for every new chunk; bigger requests get a chunk of their own size.
+	// 0 takes the chunk size of the arena's configuration.
+	size_type chunkSize;
+	// Number of fully free chunks kept for reuse before further ones are released.
+	size_type retainedFreeChunks;
+	// Upper bound on the bytes held in chunks, 0 for no limit.
+	size_type maxArenaSize;
+	ArenaBacking backing;
+	// Mapped arenas only: ask for transparent huge pages and round chunks to HUGE_PAGE_SIZE.
+	bool hugePages;
+	// Mapped arenas only: free blocks of at least purgeThreshold bytes give their
+	// interior pages back to the OS.
+	bool purgeFreePages;
+	size_type purgeThreshold;
+	// Lets several threads share the arena; None keeps it single-threaded and lock free.
+	LockingPolicy locking;
+	// Free blocks of at least this many bytes are kept in a best-fit tree keyed by
+	// (size, address) instead of the size class lists, and requests of that size take
+	// the smallest block that fits. 0 keeps every free block in the lists.
+	size_type bestFitThreshold;
+	// Freed blocks of up to this many bytes, tags included, are parked in per-size LIFO
+	// bins without being marked free or merged, and requests for exactly that block
+	// size pop them straight back. Capped at FAST_BIN_COUNT * ALIGNMENT; 0 turns fast
+	// bins off. Parked blocks count as free cells.
+	size_type fastBinSize;
+	// A fast bin reaching this many blocks is merged back into the free lists.
+	size_type fastBinLength;
+	// Requests of up to this many bytes, tags included, are cut from the free block
+	// left over by the previous such request when it is big enough, before any list is
+	// searched, so bursts of small allocations sit back to back. 0 turns it off.
+	size_type remainderReuseSize;
+	// Tracks a decaying histogram of requested sizes and only splits off a remainder
+	// when the recent requests it could serve outweigh the cost of one more free block;
+	// smaller ones stay in the block as slack. Either way a remainder needs more than
+	// 40 bytes of payload.
+	bool adaptiveSplit;
+	// Frees only mark the block free and push it on a pending list. A pass merges the
+	// pending blocks with their neighbours and files them: once coalesceThreshold frees
+	// are pending, when a request finds no fit, on coalesce(), or every
+	// coalesceInterval milliseconds on a background thread when that is not 0. The
+	// thread needs the arena lock, so it turns a None locking policy into Mutex.
+	bool deferredCoalescing;
+	size_type coalesceThreshold;
+	unsigned coalesceInterval;
+	// Serve requests of up to MAX_SMALL_SIZE bytes from bitmap runs instead of tagged
+	// blocks. Runs live outside the chunks and are not counted by the cell and byte
+	// getters or by maxArenaSize.
+	bool smallBlocks;
+};
+
+// Compile-time configuration of a BasicMemoryAllocator; MemoryAllocator uses this one.
+// A configuration names:
+//   chunkSize       - the default MemoryAllocatorOptions::chunkSize;
+//   alignment       - payload alignment and block size granularity, a power of two of
+//                     at least ALIGNMENT. Small-block runs need exactly ALIGNMENT;
+//   splitThreshold  - payload bytes a remainder needs to be split off without adaptiveSplit;
+//   search_policy   - RuntimeSearch, SegregatedSearch or TlsfSearch;
+//   lock_type       - ArenaLock, or NullLock for arenas that stay on one thread;
+//   stats_policy    - CountingStats, or NullStats to drop the occupancy counters.
+struct DefaultAllocatorConfig
+{
+	static const size_type chunkSize = 1000000;
+	static const size_type alignment = ALIGNMENT;
+	static const size_type splitThreshold = 40;
+	typedef RuntimeSearch search_policy;
+	typedef ArenaLock lock_type;
+	typedef CountingStats stats_policy;
+};
+
+template <class Config>
+class BasicMemoryAllocator
+{
+	static_assert(Config::alignment >= ALIGNMENT && (Config::alignment & (Config::alignment - 1)) == 0,
+		"block alignment must be a power of two that leaves room for the tag flags");
+
 public:
 
-	MemoryAllocator();
-	MemoryAllocator(const MemoryAllocator&);
-	MemoryAllocator& operator=(const MemoryAllocator &rhs);
-	~MemoryAllocator();
+	typedef typename Config::lock_type lock_type;
+	typedef typename Config::stats_policy stats_policy;
+
+	// Payload alignment and block size granularity of this configuration.
+	static const size_type BLOCK_ALIGNMENT = Config::alignment;
+
+	BasicMemoryAllocator();
+	explicit BasicMemoryAllocator(AllocationEngine);
+	explicit BasicMemoryAllocator(const MemoryAllocatorOptions&);
+	BasicMemoryAllocator(const BasicMemoryAllocator&);
+	BasicMemoryAllocator& operator=(const BasicMemoryAllocator &rhs);
+	~BasicMemoryAllocator();
 
 	void* allocate(size_type);
+	// Like allocate, but gives up and returns false instead of waiting for the lock.
+	bool tryAllocate(size_type, void*& result);
+	// Alignment must be a power of two. Padding in front of the block is kept as a free block.
+	void* allocateAligned(size_type, size_type alignment);
 	void deallocate(void*);
+	// Resizes in place when possible, otherwise moves the payload to a new block.
+	// On failure the old block is left untouched and nullptr is returned.
+	void* reallocate(void*, size_type);
+	// Resizes without moving: shrinking splits off the tail, growing absorbs a free
+	// right neighbour. Returns false when the block cannot grow in place.
+	bool tryExpand(void*, size_type);
+
+	// Allocates count blocks of the same size into result, cutting them back to back
+	// from as few free regions as possible. Returns how many were allocated.
+	size_type allocateBatch(size_type, size_type count, void** result);
+	// Sorts pointers by address in place and frees each run of adjacent blocks as one block.
+	void deallocateBatch(void** pointers, size_type count);
 
-	int getFreeCells() const;
-	int getUsedCells() const;
-	int getUsedAmount() const;
+	// Blocks of another arena passed to deallocate or deallocateBatch are pushed onto
+	// their owner's remote free stack without touching the owner's lists. The owner
+	// frees them on its next allocate or deallocate, or on drainRemoteFrees.
+	// deallocateRemote does the same for threads that have no arena of their own.
+	static void deallocateRemote(void*);
+	// Null for blocks of an arena with another configuration.
+	static BasicMemoryAllocator* ownerOf(const void*);
+	void drainRemoteFrees();
+
+	// Block size (tag included) that a request of n bytes occupies.
+	static size_type blockSize(size_type);
+	// Payload bytes actually available behind a pointer returned by this class.
+	// Like ownerOf and deallocateRemote, it reads the block tag, so it does not
+	// apply to untagged Buddy engine blocks.
+	static size_type usableSize(const void*);
+
+	// Occupancy is tracked incrementally, so these are constant time.
+	// Amounts are whole block sizes, tags included. Always 0 with NullStats.
+	std::uint64_t getFreeCells() const;
+	std::uint64_t getUsedCells() const;
+	std::uint64_t getUsedAmount() const;
+	std::uint64_t getFreeAmount() const;
+	int getChunkCount() const;
+	size_type getReservedBytes() const;
+	size_type getCommittedBytes() const;
+	// Smallest remainder, tags included, that a split leaves behind as a free block.
+	size_type getSplitThreshold() const;
+	// Decayed count of recent requests whose block size is bin * ALIGNMENT bytes, or
+	// larger for the last bin. Only counted with adaptiveSplit; 0 for bins outside
+	// [0, SIZE_HISTOGRAM_BINS).
+	std::uint32_t getSizeHistogram(int bin) const;
+	// Merges every block parked in the fast bins back into the free lists.
+	void consolidateFastBins();
+	// Merges the neighbouring free blocks left behind by deferred frees.
+	void coalesce();
+	// Live slots and runs held by the small-block allocator.
+	std::uint64_t getSmallBlockCount() const;
+	size_type getSmallRunCount() const;
+	// How often the arena lock was taken, and how often a caller found it held.
+	std::uint64_t getLockAcquires() const;
+	std::uint64_t getLockContentions() const;
 	void print() const;
 
+	// Walks every chunk and every free list and checks that they agree with each other.
+	// Problems go to the verify callback; without one they trip an assert.
+	bool verifyHeap() const;
+	void setVerifyCallback(VerifyCallback, void* context);
+
 private:
-	char* m_buffer;
-	node* m_freeList;
+	static const size_type TAG_SIZE = sizeof(info_header);
+	// A free block must hold its header, a list node and its footer.
+	static const size_type MIN_BLOCK_SIZE = (TAG_SIZE * 2 + sizeof(node) + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1);
+	// Smallest remainder a split leaves behind when the threshold is not adaptive.
+	static const size_type STATIC_MIN_SPLIT = MIN_BLOCK_SIZE > TAG_SIZE + Config::splitThreshold + 1 ?
+		MIN_BLOCK_SIZE : TAG_SIZE + Config::splitThreshold + 1;
+	// The first header sits one tag below a BLOCK_ALIGNMENT boundary, so every payload is aligned.
+	static const size_type CHUNK_HEADER_SIZE = ((sizeof(chunk) + TAG_SIZE + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1)) - TAG_SIZE;
+	// Chunk struct and epilogue.
+	static const size_type CHUNK_OVERHEAD = CHUNK_HEADER_SIZE + TAG_SIZE;
+	// Its address tells the arenas of this configuration apart in the registry.
+	static const char s_config;
+
+	// What a heap walk found, compared against the running counters by verifyHeap.
+	struct heap_totals
+	{
+		std::uint64_t freeBlocks;
+		std::uint64_t usedBlocks;
+		std::uint64_t freeBytes;
+		std::uint64_t usedBytes;
+		size_type freeChunks;
+	};
+
+	MemoryAllocatorOptions m_options;
+	mutable lock_type m_lock;
+	// Set for the Buddy engine, which then owns all non-small blocks.
+	std::unique_ptr<BuddyHeap> m_buddy;
+	// Index in the arena registry, 0 when the registry was full.
+	int m_arenaId;
+	std::uint64_t m_arenaTag;
+	chunk* m_chunks;
+	int m_chunkCount;
+	size_type m_freeChunkCount;
+	typename stats_policy::counter m_freeBlocks;
+	typename stats_policy::counter m_usedBlocks;
+	typename stats_policy::counter m_freeBytes;
+	typename stats_policy::counter m_usedBytes;
+	size_type m_reservedBytes;
+	size_type m_committedBytes;
+	size_type m_pageSize;
+	AllocationEngine m_engine;
+	VerifyCallback m_verifyCallback;
+	void* m_verifyContext;
+	node* m_freeLists[SIZE_CLASS_COUNT][SUB_CLASS_COUNT];
+	// The free block at the end of the newest chunk, kept out of the lists so requests
+	// they miss are cut from it at the low end. m_topEnd is that chunk's epilogue.
+	info_header* m_top;
+	info_header* m_topEnd;
+	// The free block after the last small allocation; it stays filed wherever it is.
+	info_header* m_lastRemainder;
+	size_type m_minSplit;
+	std::uint32_t m_sizeHistogram[SIZE_HISTOGRAM_BINS];
+	std::uint32_t m_periodRequests;
+	// Next-fit only: where the next search of each segregated class starts.
+	node* m_rovers[SIZE_CLASS_COUNT];
+	tree_node* m_largeFreeBlocks;
+	size_type m_bestFitThreshold;
+	std::uint64_t m_nonEmptyClasses;
+	std::uint32_t m_nonEmptySubClasses[SIZE_CLASS_COUNT];
+	// Freed blocks waiting for reuse at their exact size, linked through next. Their
+	// tags stay used, so they count in m_usedBlocks and are left out by the getters.
+	node* m_fastBins[FAST_BIN_COUNT];
+	size_type m_fastBinLengths[FAST_BIN_COUNT];
+	size_type m_fastBinSize;
+	std::uint64_t m_fastBlocks;
+	std::uint64_t m_fastBytes;
+	// Deferred frees waiting for a coalescing pass, linked like a free list. They are
+	// not reused until the pass files them.
+	node* m_pendingBlocks;
+	std::uint64_t m_pendingFrees;
+	std::unique_ptr<coalescer_thread> m_coalescer;
+	// Runs with free slots per class; full runs only sit on m_fullRuns.
+	small_run* m_smallRuns[SMALL_CLASS_COUNT];
+	small_run* m_fullRuns;
+	std::uint64_t m_smallBlocks;
+	size_type m_smallRunCount;
+	// Blocks freed by other threads, linked through their payloads. Any thread pushes,
+	// only the owner takes the whole stack.
+	char m_remotePadding[CACHE_LINE_SIZE];
+	std::atomic<node*> m_remoteFrees;
+	char m_remoteTailPadding[CACHE_LINE_SIZE];
+	arena_record m_record;
 
 	void init();
 
+	// Bodies of the public calls, run with the lock held.
+	void* allocateBlock(size_type);
+	void deallocateBlock(void*);
+	bool expandBlock(void*, size_type);
+
+	void pushRemote(void*);
+	static void pushRemote(arena_record*, void*);
+	void freeRemoteBlocks();
+
+	void* allocateSmall(size_type);
+	void freeSmall(void*);
+	void releaseSmallRuns(small_run*);
+
+	// Miss path of every allocation call: merges parked and deferred frees and searches
+	// again, for wanted bytes and then for at least size, before it adds a chunk.
+	node* missedFit(size_type wanted, size_type size);
+	node* addChunk(size_type);
+	void releaseChunk(chunk*);
+
+	info_header* takeBlock(node*);
+	void* carveBlock(info_header*, size_type available, size_type size);
+	void freeBlock(info_header*);
+	// Marks the block free and files it, or releases its chunk when the block spans all
+	// of it and enough free chunks are retained already. False when the chunk went.
+	bool fileFreeBlock(info_header*, size_type);
+
+	void pushPending(info_header*);
+	void coalescePending();
+	void runCoalescer();
+
+	void pushFast(info_header*);
+	void releaseFastBin(int);
+	void releaseFastBins();
+
+	bool purgeRange(info_header*, char*& begin, char*& end) const;
+	void purgeBlock(info_header*);
+	void recommitBlock(info_header*);
+
+	void recordRequest(size_type);
+
+	static void mapping(size_type, int& sizeClassIndex, int& subClassIndex);
+	void binIndex(size_type, int& sizeClassIndex, int& subClassIndex) const;
+	node* findFit(size_type);
+	node* findSegregatedFit(size_type);
+	node* findTlsfFit(size_type);
+
 	void addNode(node*);
 	void removeNode(node*);
 
-	bool freeListCheck();
-};
\ No newline at end of file
+	bool checkHeap() const;
+	bool report(const char* message, const void* address) const;
+	bool verifyChunk(const chunk*, heap_totals&) const;
+	bool verifyFreeLists(std::uint64_t& listedBlocks) const;
+	bool verifyFastBins() const;
+	bool verifySmallRuns() const;
+};
+
+typedef BasicMemoryAllocator<DefaultAllocatorConfig> MemoryAllocator;
+
+// Compiled once in MemoryAllocator.cpp. Other configurations include MemoryAllocatorImpl.h.
+extern template class BasicMemoryAllocator<DefaultAllocatorConfig>;
@@ -0,0 +1,2463 @@
+#pragma once
+#include "MemoryAllocator.h"
+#include "ArenaRegistry.h"
+#include "BitOps.h"
+#include "BuddyHeap.h"
+#include "FreeTree.h"
+#include "PageSource.h"
+#include "SmallBlocks.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <limits>
+#include <thread>
+
+// Member definitions of BasicMemoryAllocator. MemoryAllocator.cpp instantiates the
+// default configuration; include this header to instantiate any other.
+
+// Adaptive splitting: the histogram is halved and the threshold recomputed every
+// HISTOGRAM_PERIOD requests.
+const std::uint32_t HISTOGRAM_PERIOD = 4096;
+
+inline info_header* headerOf(node* freeNode)
+{
+	return reinterpret_cast<info_header*>(freeNode) - 1;
+}
+
+inline node* nodeOf(info_header* header)
+{
+	return reinterpret_cast<node*>(header + 1);
+}
+
+inline info_header* nextBlock(info_header* header)
+{
+	return reinterpret_cast<info_header*>(reinterpret_cast<char*>(header) + header->size());
+}
+
+inline info_header* footerOf(info_header* header)
+{
+	return reinterpret_cast<info_header*>(reinterpret_cast<char*>(header) + header->size()) - 1;
+}
+
+// Only valid when header->isPrevFree(), since only free blocks have a footer.
+inline info_header* previousBlock(info_header* header)
+{
+	return reinterpret_cast<info_header*>(reinterpret_cast<char*>(header) - (header - 1)->size());
+}
+
+// Position flags describe the block's surroundings and survive every rewrite of its tag.
+// Footer only: the block was freed in deferred mode and sits on the pending list
+// until a coalescing pass. Footers carry no position flags, so the bit is unused there.
+const std::uint64_t PENDING_BIT = FIRST_BIT;
+
+inline bool isPending(const info_header* header)
+{
+	return (reinterpret_cast<const info_header*>(reinterpret_cast<const char*>(header) + header->size()) - 1)->m_tag & PENDING_BIT;
+}
+
+inline void writeFree(info_header* header, size_type size)
+{
+	header->m_tag = size | FREE_BIT | (header->m_tag & (FIRST_BIT | PREV_FREE_BIT));
+	footerOf(header)->m_tag = size | FREE_BIT;
+	nextBlock(header)->setPrevFree(true);
+}
+
+inline void writeUsed(info_header* header, size_type size, std::uint64_t arenaTag)
+{
+	header->m_tag = size | arenaTag | (header->m_tag & (FIRST_BIT | PREV_FREE_BIT));
+	nextBlock(header)->setPrevFree(false);
+}
+
+inline int arenaOf(const void* pointer)
+{
+	if (isSmallBlock(pointer))
+	{
+		return runOf(pointer)->arena;
+	}
+
+	// The owner may flip PREV_FREE_BIT in this tag at any time; the arena bits of a
+	// used block never change.
+	return static_cast<int>((static_cast<const info_header*>(pointer) - 1)->sharedTag() >> ARENA_SHIFT);
+}
+
+// Runs the background coalescing passes of a deferred arena.
+struct coalescer_thread
+{
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stop;
+	std::thread thread;
+};
+
+// The background coalescer shares the arena, so it cannot do without a lock.
+inline LockingPolicy lockingFor(const MemoryAllocatorOptions& options)
+{
+	if (options.deferredCoalescing && options.coalesceInterval && options.locking == LockingPolicy::None)
+	{
+		return LockingPolicy::Mutex;
+	}
+
+	return options.locking;
+}
+
+inline MemoryAllocatorOptions engineOptions(AllocationEngine engine)
+{
+	MemoryAllocatorOptions options;
+	options.engine = engine;
+	return options;
+}
+
+template <class Config>
+const size_type BasicMemoryAllocator<Config>::BLOCK_ALIGNMENT;
+template <class Config>
+const size_type BasicMemoryAllocator<Config>::TAG_SIZE;
+template <class Config>
+const size_type BasicMemoryAllocator<Config>::MIN_BLOCK_SIZE;
+template <class Config>
+const size_type BasicMemoryAllocator<Config>::STATIC_MIN_SPLIT;
+template <class Config>
+const size_type BasicMemoryAllocator<Config>::CHUNK_HEADER_SIZE;
+template <class Config>
+const size_type BasicMemoryAllocator<Config>::CHUNK_OVERHEAD;
+template <class Config>
+const char BasicMemoryAllocator<Config>::s_config = 0;
+
+template <class Config>
+BasicMemoryAllocator<Config>::BasicMemoryAllocator() : BasicMemoryAllocator(MemoryAllocatorOptions())
+{}
+
+template <class Config>
+BasicMemoryAllocator<Config>::BasicMemoryAllocator(AllocationEngine engine) : BasicMemoryAllocator(engineOptions(engine))
+{}
+
+template <class Config>
+BasicMemoryAllocator<Config>::BasicMemoryAllocator(const MemoryAllocatorOptions& options)
+	: m_options(options), m_lock(lockingFor(options)), m_arenaId(0), m_arenaTag(0), m_chunks(nullptr), m_chunkCount(0), m_freeChunkCount(0),
+	m_freeBlocks(0), m_usedBlocks(0), m_freeBytes(0), m_usedBytes(0), m_reservedBytes(0), m_committedBytes(0),
+	m_pageSize(systemPageSize()), m_engine(Config::search_policy::engine(options.engine)), m_verifyCallback(nullptr), m_verifyContext(nullptr)
+{
+	if (m_options.backing != ArenaBacking::Mapped)
+	{
+		m_options.hugePages = false;
+		m_options.purgeFreePages = false;
+	}
+
+	if (!m_options.chunkSize)
+	{
+		m_options.chunkSize = Config::chunkSize;
+	}
+
+	// Runs are cut into ALIGNMENT-sized slots, which a coarser configuration cannot hand out.
+	if (BLOCK_ALIGNMENT != ALIGNMENT)
+	{
+		m_options.smallBlocks = false;
+	}
+
+	m_options.engine = m_engine;
+	m_options.locking = m_lock.policy();
+	m_pendingBlocks = nullptr;
+	m_pendingFrees = 0;
+
+	m_remoteFrees.store(nullptr, std::memory_order_relaxed);
+	m_fullRuns = nullptr;
+	m_smallBlocks = 0;
+	m_smallRunCount = 0;
+
+	for (int i = 0; i < SMALL_CLASS_COUNT; i++)
+	{
+		m_smallRuns[i] = nullptr;
+	}
+
+	m_record.arena = this;
+	m_record.config = &s_config;
+	m_record.remoteFrees = &m_remoteFrees;
+	m_arenaId = registerArena(&m_record);
+	m_arenaTag = std::uint64_t(m_arenaId) << ARENA_SHIFT;
+
+	init();
+
+	// A NullLock arena has no lock to share with the thread; its passes stay on the
+	// threshold, on misses and on coalesce().
+	if (m_options.deferredCoalescing && m_options.coalesceInterval && !m_buddy && m_lock.policy() != LockingPolicy::None)
+	{
+		m_coalescer.reset(new coalescer_thread());
+		m_coalescer->stop = false;
+		m_coalescer->thread = std::thread([this] { runCoalescer(); });
+	}
+}
+
+template <class Config>
+BasicMemoryAllocator<Config>::BasicMemoryAllocator(const BasicMemoryAllocator& other) : BasicMemoryAllocator(other.m_options)
+{}
+
+template <class Config>
+BasicMemoryAllocator<Config>& BasicMemoryAllocator<Config>::operator=(const BasicMemoryAllocator & rhs)
+{
+	return *this;
+}
+
+template <class Config>
+BasicMemoryAllocator<Config>::~BasicMemoryAllocator()
+{
+	if (m_coalescer)
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_coalescer->mutex);
+			m_coalescer->stop = true;
+		}
+
+		m_coalescer->wake.notify_one();
+		m_coalescer->thread.join();
+	}
+
+	if (m_arenaId)
+	{
+		unregisterArena(m_arenaId);
+	}
+
+	for (int i = 0; i < SMALL_CLASS_COUNT; i++)
+	{
+		releaseSmallRuns(m_smallRuns[i]);
+	}
+
+	releaseSmallRuns(m_fullRuns);
+
+	while (m_chunks)
+	{
+		releaseChunk(m_chunks);
+	}
+}
+
+template <class Config>
+void * BasicMemoryAllocator<Config>::allocate(size_type n)
+{
+	std::lock_guard<lock_type> guard(m_lock);
+	return allocateBlock(n);
+}
+
+template <class Config>
+bool BasicMemoryAllocator<Config>::tryAllocate(size_type n, void*& result)
+{
+	if (!m_lock.try_lock())
+	{
+		return false;
+	}
+
+	std::lock_guard<lock_type> guard(m_lock, std::adopt_lock);
+	result = allocateBlock(n);
+	return true;
+}
+
+template <class Config>
+void * BasicMemoryAllocator<Config>::allocateBlock(size_type n)
+{
+	if (n > std::numeric_limits<size_type>::max() - MIN_BLOCK_SIZE - BLOCK_ALIGNMENT)
+	{
+		return nullptr;
+	}
+
+	if (m_remoteFrees.load(std::memory_order_relaxed))
+	{
+		freeRemoteBlocks();
+	}
+
+	if (m_options.smallBlocks && n <= MAX_SMALL_SIZE)
+	{
+		void* small = allocateSmall(n);
+
+		// Falls through to a tagged block once the shared run range is used up.
+		if (small)
+		{
+#if MEMORY_ALLOCATOR_DEBUG_CHECKS
+			checkHeap();
+#endif
+			return small;
+		}
+	}
+
+	if (m_buddy)
+	{
+		void* result = m_buddy->allocate(n, BLOCK_ALIGNMENT);
+
+#if MEMORY_ALLOCATOR_DEBUG_CHECKS
+		checkHeap();
+#endif
+
+		return result;
+	}
+
+	size_type size = blockSize(n);
+
+	if (m_options.adaptiveSplit)
+	{
+		recordRequest(size);
+	}
+
+	if (size <= m_fastBinSize && m_fastBins[size / ALIGNMENT - 1])
+	{
+		int index = static_cast<int>(size / ALIGNMENT - 1);
+		node* reused = m_fastBins[index];
+
+		m_fastBins[index] = reused->next;
+		m_fastBinLengths[index]--;
+		m_fastBlocks--;
+		m_fastBytes -= size;
+
+#if MEMORY_ALLOCATOR_DEBUG_CHECKS
+		checkHeap();
+#endif
+
+		return reused;
+	}
+
+	node* currentNode = nullptr;
+
+	// Small bursts keep carving the block the previous one was cut from, before any list is searched.
+	bool small = size <= m_options.remainderReuseSize;
+
+	if (small && m_lastRemainder && m_lastRemainder->size() >= size)
+	{
+		currentNode = nodeOf(m_lastRemainder);
+	}
+	else
+	{
+		currentNode = findFit(size);
+	}
+
+	if (!currentNode)
+	{
+		currentNode = missedFit(size, size);
+
+		if (!currentNode)
+		{
+			return nullptr;
+		}
+	}
+
+	info_header* currentHeader = takeBlock(currentNode);
+	void* result = carveBlock(currentHeader, currentHeader->size(), size);
+
+	if (small)
+	{
+		info_header* rest = nextBlock(currentHeader);
+
+		m_lastRemainder = rest->isFree() && !isPending(rest) ? rest : nullptr;
+	}
+
+#if MEMORY_ALLOCATOR_DEBUG_CHECKS
+	checkHeap();
+#endif
+
+	return result;
+}
+
+template <class Config>
+void * BasicMemoryAllocator<Config>::allocateAligned(size_type n, size_type alignment)
+{
+	if (alignment & (alignment - 1))
+	{
+		return nullptr;
+	}
+
+	std::lock_guard<lock_type> guard(m_lock);
+
+	if (alignment <= BLOCK_ALIGNMENT)
+	{
+		return allocateBlock(n);
+	}
+
+	if (n > std::numeric_limits<size_type>::max() - MIN_BLOCK_SIZE - BLOCK_ALIGNMENT - alignment)
+	{
+		return nullptr;
+	}
+
+	if (m_remoteFrees.load(std::memory_order_relaxed))
+	{
+		freeRemoteBlocks();
+	}
+
+	// Buddy blocks are aligned to their own size, so the block is simply made big enough.
+	if (m_buddy)
+	{
+		void* result = m_buddy->allocate(n, alignment);
+
+#if MEMORY_ALLOCATOR_DEBUG_CHECKS
+		checkHeap();
+#endif
+
+		return result;
+	}
+
+	// Enough room for the block at any offset, with a lead that is either empty or a valid free block.
+	size_type size = blockSize(n);
+	size_type needed = size + alignment + MIN_BLOCK_SIZE;
+	node* currentNode = findFit(needed);
+
+	if (!currentNode)
+	{
+		currentNode = missedFit(needed, needed);
+
+		if (!currentNode)
+		{
+			return nullptr;
+		}
+	}
+
+	info_header* currentHeader = takeBlock(currentNode);
+	size_type available = currentHeader->size();
+
+	size_type payload = reinterpret_cast<size_type>(nodeOf(currentHeader));
+	size_type aligned = (payload + alignment - 1) & ~(alignment - 1);
+
+	if (aligned != payload && aligned - payload < MIN_BLOCK_SIZE)
+	{
+		aligned += alignment;
+	}
+
+	size_type lead = aligned - payload;
+
+	// The padding in front becomes a free block of its own instead of being wasted.
+	if (lead)
+	{
+		info_header* alignedHeader = reinterpret_cast<info_header*>(aligned) - 1;
+		alignedHeader->m_tag = 0;
+		writeFree(currentHeader, lead);
+		addNode(nodeOf(currentHeader));
+
+		m_freeBlocks++;
+		m_freeBytes += lead;
+
+		currentHeader = alignedHeader;
+		available -= lead;
+	}
+
+	void* result = carveBlock(currentHeader, available, size);
+
+#if MEMORY_ALLOCATOR_DEBUG_CHECKS
+	checkHeap();
+#endif
+
+	return result;
+}
+
+template <class Config>
+size_type BasicMemoryAllocator<Config>::allocateBatch(size_type n, size_type count, void** result)
+{
+	if (!count || n > std::numeric_limits<size_type>::max() - MIN_BLOCK_SIZE - BLOCK_ALIGNMENT)
+	{
+		return 0;
+	}
+
+	std::lock_guard<lock_type> guard(m_lock);
+
+	if (m_remoteFrees.load(std::memory_order_relaxed))
+	{
+		freeRemoteBlocks();
+	}
+
+	size_type size = blockSize(n);
+	size_type allocated = 0;
+
+	while (m_buddy && allocated < count)
+	{
+		result[allocated] = m_buddy->allocate(n, BLOCK_ALIGNMENT);
+
+		if (!result[allocated])
+		{
+			break;
+		}
+
+		allocated++;
+	}
+
+	while (!m_buddy && allocated < count)
+	{
+		size_type remaining = count - allocated;
+		size_type wanted = remaining <= std::numeric_limits<size_type>::max() / size ? remaining * size : size;
+
+		// Prefer one region holding the whole rest of the batch, then settle for anything that fits a block.
+		node* currentNode = findFit(wanted);
+
+		if (!currentNode)
+		{
+			currentNode = findFit(size);
+		}
+
+		if (!currentNode)
+		{
+			currentNode = missedFit(wanted, size);
+		}
+
+		if (!currentNode)
+		{
+			break;
+		}
+
+		info_header* currentHeader = takeBlock(currentNode);
+		size_type available = currentHeader->size();
+		size_type blocks = available / size;
+
+		if (blocks > remaining)
+		{
+			blocks = remaining;
+		}
+
+		// All but the last block are cut back to back; the last one splits off whatever is left.
+		for (size_type i = 1; i < blocks; i++)
+		{
+			writeUsed(currentHeader, size, m_arenaTag);
+			result[allocated++] = nodeOf(currentHeader);
+
+			m_usedBlocks++;
+			m_usedBytes += size;
+			available -= size;
+
+			currentHeader = nextBlock(currentHeader);
+			currentHeader->m_tag = 0;
+		}
+
+		result[allocated++] = carveBlock(currentHeader, available, size);
+	}
+
+#if MEMORY_ALLOCATOR_DEBUG_CHECKS
+	checkHeap();
+#endif
+
+	return allocated;
+}
+
+template <class Config>
+node* BasicMemoryAllocator<Config>::missedFit(size_type wanted, size_type size)
+{
+	node* result = nullptr;
+
+	// Parked blocks and deferred frees may merge into a fit before the arena grows.
+	if (m_fastBlocks || m_pendingFrees)
+	{
+		releaseFastBins();
+
+		if (m_pendingFrees)
+		{
+			coalescePending();
+		}
+
+		result = findFit(wanted);
+
+		if (!result && size < wanted)
+		{
+			result = findFit(size);
+		}
+	}
+
+	if (!result)
+	{
+		result = addChunk(wanted);
+	}
+
+	if (!result && size < wanted)
+	{
+		result = addChunk(size);
+	}
+
+	return result;
+}
+
+template <class Config>
+info_header* BasicMemoryAllocator<Config>::takeBlock(node* freeNode)
+{
+	info_header* header = headerOf(freeNode);
+
+	removeNode(freeNode);
+
+	if (header->isPurged())
+	{
+		recommitBlock(header);
+	}
+
+	// A first block followed by the epilogue is a whole free chunk that is now being used again.
+	if (header->isFirst() && nextBlock(header)->size() == 0)
+	{
+		m_freeChunkCount--;
+	}
+
+	m_freeBlocks--;
+	m_freeBytes -= header->size();
+
+	return header;
+}
+
+template <class Config>
+void* BasicMemoryAllocator<Config>::carveBlock(info_header* header, size_type available, size_type size)
+{
+	size_type remainder = available - size;
+
+	// Split only when the remainder is big enough to be worth keeping.
+	if (remainder >= m_minSplit)
+	{
+		writeUsed(header, size, m_arenaTag);
+
+		info_header* newBegin = nextBlock(header);
+		newBegin->m_tag = 0;
+		writeFree(newBegin, remainder);
+
+		addNode(nodeOf(newBegin));
+
+		m_freeBlocks++;
+		m_freeBytes += remainder;
+	}
+	else
+	{
+		writeUsed(header, available, m_arenaTag);
+	}
+
+	m_usedBlocks++;
+	m_usedBytes += header->size();
+
+	return nodeOf(header);
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::deallocate(void* pointer)
+{
+	if (!pointer)
+	{
+		return;
+	}
+
+	std::lock_guard<lock_type> guard(m_lock);
+	deallocateBlock(pointer);
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::deallocateBlock(void* pointer)
+{
+	if (m_remoteFrees.load(std::memory_order_relaxed))
+	{
+		freeRemoteBlocks();
+	}
+
+	if (m_buddy && !isSmallBlock(pointer))
+	{
+		// Buddy blocks carry no tag, so one from another arena cannot be routed to its owner.
+		if (!m_buddy->owns(pointer))
+		{
+			assert(!"block does not belong to this buddy arena");
+			return;
+		}
+
+		m_buddy->deallocate(pointer);
+	}
+	else if (arenaOf(pointer) != m_arenaId)
+	{
+		pushRemote(pointer);
+		return;
+	}
+	else if (isSmallBlock(pointer))
+	{
+		freeSmall(pointer);
+	}
+	else if ((static_cast<info_header*>(pointer) - 1)->size() <= m_fastBinSize)
+	{
+		pushFast(static_cast<info_header*>(pointer) - 1);
+	}
+	else
+	{
+		freeBlock(static_cast<info_header*>(pointer) - 1);
+	}
+
+#if MEMORY_ALLOCATOR_DEBUG_CHECKS
+	checkHeap();
+#endif
+}
+
+template <class Config>
+void * BasicMemoryAllocator<Config>::reallocate(void* pointer, size_type n)
+{
+	std::lock_guard<lock_type> guard(m_lock);
+
+	if (!pointer)
+	{
+		return allocateBlock(n);
+	}
+
+	if (!n)
+	{
+		deallocateBlock(pointer);
+		return nullptr;
+	}
+
+	if (m_buddy && !isSmallBlock(pointer) && !m_buddy->owns(pointer))
+	{
+		assert(!"block does not belong to this buddy arena");
+		return nullptr;
+	}
+
+	if (expandBlock(pointer, n))
+	{
+		return pointer;
+	}
+
+	void* result = allocateBlock(n);
+
+	if (result)
+	{
+		size_type oldSize = m_buddy && !isSmallBlock(pointer) ? m_buddy->usableSize(pointer) : usableSize(pointer);
+		std::memcpy(result, pointer, oldSize < n ? oldSize : n);
+		deallocateBlock(pointer);
+	}
+
+	return result;
+}
+
+template <class Config>
+bool BasicMemoryAllocator<Config>::tryExpand(void* pointer, size_type n)
+{
+	std::lock_guard<lock_type> guard(m_lock);
+	return expandBlock(pointer, n);
+}
+
+template <class Config>
+bool BasicMemoryAllocator<Config>::expandBlock(void* pointer, size_type n)
+{
+	if (n > std::numeric_limits<size_type>::max() - MIN_BLOCK_SIZE - BLOCK_ALIGNMENT)
+	{
+		return false;
+	}
+
+	// Slots never change size.
+	if (isSmallBlock(pointer))
+	{
+		return n <= usableSize(pointer);
+	}
+
+	if (m_buddy)
+	{
+		if (!m_buddy->owns(pointer))
+		{
+			return false;
+		}
+
+		bool result = m_buddy->tryExpand(pointer, n);
+
+#if MEMORY_ALLOCATOR_DEBUG_CHECKS
+		checkHeap();
+#endif
+
+		return result;
+	}
+
+	// Another arena's block and its neighbours are guarded by that arena's lock, so
+	// reallocate moves it and hands the old block back through the remote free stack.
+	if (arenaOf(pointer) != m_arenaId)
+	{
+		return false;
+	}
+
+	info_header* header = static_cast<info_header*>(pointer) - 1;
+	size_type size = blockSize(n);
+	size_type available = header->size();
+
+	if (size > available)
+	{
+		// Growing only works by absorbing a free right neighbour, found through the block's own size.
+		info_header* rightBegin = nextBlock(header);
+
+		// A pending neighbour can border free blocks that are already filed, and the
+		// split below would file its leftover next to them. Merging first avoids that.
+		if (rightBegin->isFree() && isPending(rightBegin))
+		{
+			coalescePending();
+		}
+
+		if (!rightBegin->isFree() || available + rightBegin->size() < size)
+		{
+			return false;
+		}
+
+		takeBlock(nodeOf(rightBegin));
+		available += rightBegin->size();
+
+		m_usedBlocks--;
+		m_usedBytes -= header->size();
+
+		carveBlock(header, available, size);
+	}
+	else
+	{
+		size_type remainder = available - size;
+
+		// The tail is handed to freeBlock as a used block, so it coalesces like any other free.
+		if (remainder >= m_minSplit)
+		{
+			writeUsed(header, size, m_arenaTag);
+
+			info_header* tail = nextBlock(header);
+			tail->m_tag = 0;
+			writeUsed(tail, remainder, m_arenaTag);
+			m_usedBlocks++;
+
+			freeBlock(tail);
+		}
+	}
+
+#if MEMORY_ALLOCATOR_DEBUG_CHECKS
+	checkHeap();
+#endif
+
+	return true;
+}
+
+inline bool addressLess(void* left, void* right)
+{
+	return std::less<void*>()(left, right);
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::deallocateBatch(void** pointers, size_type count)
+{
+	std::lock_guard<lock_type> guard(m_lock);
+
+	if (m_remoteFrees.load(std::memory_order_relaxed))
+	{
+		freeRemoteBlocks();
+	}
+
+	std::sort(pointers, pointers + count, addressLess);
+
+	size_type i = 0;
+
+	while (i < count && !pointers[i])
+	{
+		i++;
+	}
+
+	while (i < count)
+	{
+		// Blocks that sit back to back are fused into one used block, which is then freed once.
+		if (m_buddy && !isSmallBlock(pointers[i]))
+		{
+			assert(m_buddy->owns(pointers[i]) && "block does not belong to this buddy arena");
+
+			if (m_buddy->owns(pointers[i]))
+			{
+				m_buddy->deallocate(pointers[i]);
+			}
+
+			i++;
+			continue;
+		}
+
+		if (arenaOf(pointers[i]) != m_arenaId)
+		{
+			pushRemote(pointers[i]);
+			i++;
+			continue;
+		}
+
+		if (isSmallBlock(pointers[i]))
+		{
+			freeSmall(pointers[i]);
+			i++;
+			continue;
+		}
+
+		info_header* begin = static_cast<info_header*>(pointers[i]) - 1;
+
+		info_header* end = nextBlock(begin);
+		size_type runLength = 1;
+
+		for (i++; i < count && static_cast<info_header*>(pointers[i]) - 1 == end; i++)
+		{
+			end = nextBlock(end);
+			runLength++;
+		}
+
+		if (runLength > 1)
+		{
+			writeUsed(begin, reinterpret_cast<char*>(end) - reinterpret_cast<char*>(begin), m_arenaTag);
+			m_usedBlocks -= runLength - 1;
+		}
+
+		freeBlock(begin);
+	}
+
+#if MEMORY_ALLOCATOR_DEBUG_CHECKS
+	checkHeap();
+#endif
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::freeBlock(info_header* begin)
+{
+	size_type size = begin->size();
+
+	// Every merge below folds one existing free block into this one.
+	m_usedBlocks--;
+	m_usedBytes -= size;
+	m_freeBlocks++;
+	m_freeBytes += size;
+
+	if (m_options.deferredCoalescing)
+	{
+		pushPending(begin);
+
+		if (m_pendingFrees >= m_options.coalesceThreshold)
+		{
+			coalescePending();
+		}
+
+		return;
+	}
+
+	// Neighbours are unlinked before the sizes change, so they leave the size class they were filed under.
+	// The first block of a chunk never has PREV_FREE_BIT and the epilogue is never free,
+	// so no bounds checks are needed.
+	// Merging case current memory block with left free memory block
+	if (begin->isPrevFree())
+	{
+		info_header* leftBegin = previousBlock(begin);
+
+		removeNode(nodeOf(leftBegin));
+
+		if (leftBegin->isPurged())
+		{
+			recommitBlock(leftBegin);
+		}
+
+		size += leftBegin->size();
+		begin = leftBegin;
+		m_freeBlocks--;
+	}
+
+	// Merging case current memory block with right free memory block
+	info_header* rightBegin = reinterpret_cast<info_header*>(reinterpret_cast<char*>(begin) + size);
+
+	if (rightBegin->isFree())
+	{
+		removeNode(nodeOf(rightBegin));
+
+		if (rightBegin->isPurged())
+		{
+			recommitBlock(rightBegin);
+		}
+
+		size += rightBegin->size();
+		m_freeBlocks--;
+	}
+
+	fileFreeBlock(begin, size);
+}
+
+template <class Config>
+bool BasicMemoryAllocator<Config>::fileFreeBlock(info_header* begin, size_type size)
+{
+	info_header* rightBegin = reinterpret_cast<info_header*>(reinterpret_cast<char*>(begin) + size);
+
+	// Reaching the epilogue from the first block means the whole chunk is free again.
+	if (begin->isFirst() && rightBegin->size() == 0)
+	{
+		if (m_freeChunkCount >= m_options.retainedFreeChunks)
+		{
+			m_freeBlocks--;
+			m_freeBytes -= size;
+			releaseChunk(reinterpret_cast<chunk*>(reinterpret_cast<char*>(begin) - CHUNK_HEADER_SIZE));
+			return false;
+		}
+
+		m_freeChunkCount++;
+	}
+
+	writeFree(begin, size);
+
+	if (m_options.purgeFreePages && size >= m_options.purgeThreshold)
+	{
+		purgeBlock(begin);
+	}
+
+	addNode(nodeOf(begin));
+	return true;
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::coalesce()
+{
+	std::lock_guard<lock_type> guard(m_lock);
+	coalescePending();
+
+#if MEMORY_ALLOCATOR_DEBUG_CHECKS
+	checkHeap();
+#endif
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::runCoalescer()
+{
+	std::unique_lock<std::mutex> lock(m_coalescer->mutex);
+	std::chrono::milliseconds interval(m_options.coalesceInterval);
+
+	while (!m_coalescer->wake.wait_for(lock, interval, [this] { return m_coalescer->stop; }))
+	{
+		lock.unlock();
+
+		{
+			std::lock_guard<lock_type> guard(m_lock);
+
+			if (m_pendingFrees)
+			{
+				coalescePending();
+			}
+		}
+
+		lock.lock();
+	}
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::pushPending(info_header* begin)
+{
+	node* pending = nodeOf(begin);
+
+	writeFree(begin, begin->size());
+	footerOf(begin)->m_tag |= PENDING_BIT;
+
+	pending->previous = nullptr;
+	pending->next = m_pendingBlocks;
+
+	if (pending->next)
+	{
+		pending->next->previous = pending;
+	}
+
+	m_pendingBlocks = pending;
+	m_pendingFrees++;
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::coalescePending()
+{
+	while (m_pendingBlocks)
+	{
+		info_header* begin = headerOf(m_pendingBlocks);
+		size_type size = begin->size();
+
+		removeNode(m_pendingBlocks);
+
+		// Runs of free blocks can reach out on both sides, filed or pending alike.
+		while (begin->isPrevFree())
+		{
+			info_header* leftBegin = previousBlock(begin);
+
+			removeNode(nodeOf(leftBegin));
+
+			if (leftBegin->isPurged())
+			{
+				recommitBlock(leftBegin);
+			}
+
+			size += leftBegin->size();
+			begin = leftBegin;
+			m_freeBlocks--;
+		}
+
+		info_header* rightBegin = reinterpret_cast<info_header*>(reinterpret_cast<char*>(begin) + size);
+
+		while (rightBegin->isFree())
+		{
+			removeNode(nodeOf(rightBegin));
+
+			if (rightBegin->isPurged())
+			{
+				recommitBlock(rightBegin);
+			}
+
+			size += rightBegin->size();
+			rightBegin = reinterpret_cast<info_header*>(reinterpret_cast<char*>(begin) + size);
+			m_freeBlocks--;
+		}
+
+		fileFreeBlock(begin, size);
+	}
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::pushFast(info_header* header)
+{
+	int index = static_cast<int>(header->size() / ALIGNMENT - 1);
+	node* parked = nodeOf(header);
+
+	// The tag stays used, so neither neighbour can merge with the block while it is parked.
+	parked->next = m_fastBins[index];
+	m_fastBins[index] = parked;
+	m_fastBlocks++;
+	m_fastBytes += header->size();
+
+	if (++m_fastBinLengths[index] >= m_options.fastBinLength)
+	{
+		releaseFastBin(index);
+	}
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::releaseFastBin(int index)
+{
+	node* current = m_fastBins[index];
+
+	m_fastBins[index] = nullptr;
+	m_fastBinLengths[index] = 0;
+
+	while (current)
+	{
+		node* next = current->next;
+
+		m_fastBlocks--;
+		m_fastBytes -= headerOf(current)->size();
+		freeBlock(headerOf(current));
+
+		current = next;
+	}
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::releaseFastBins()
+{
+	for (int i = 0; i < FAST_BIN_COUNT && m_fastBlocks; i++)
+	{
+		releaseFastBin(i);
+	}
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::consolidateFastBins()
+{
+	std::lock_guard<lock_type> guard(m_lock);
+	releaseFastBins();
+
+#if MEMORY_ALLOCATOR_DEBUG_CHECKS
+	checkHeap();
+#endif
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::deallocateRemote(void* pointer)
+{
+	if (!pointer)
+	{
+		return;
+	}
+
+	arena_record* owner = registeredArena(arenaOf(pointer));
+	assert(owner && "block has no owning arena");
+
+	if (owner)
+	{
+		pushRemote(owner, pointer);
+	}
+}
+
+template <class Config>
+BasicMemoryAllocator<Config>* BasicMemoryAllocator<Config>::ownerOf(const void* pointer)
+{
+	arena_record* owner = registeredArena(arenaOf(pointer));
+
+	return owner && owner->config == &s_config ? static_cast<BasicMemoryAllocator*>(owner->arena) : nullptr;
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::drainRemoteFrees()
+{
+	std::lock_guard<lock_type> guard(m_lock);
+	freeRemoteBlocks();
+
+#if MEMORY_ALLOCATOR_DEBUG_CHECKS
+	checkHeap();
+#endif
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::pushRemote(void* pointer)
+{
+	arena_record* owner = registeredArena(arenaOf(pointer));
+
+	assert(owner && "block has no owning arena");
+
+	pushRemote(owner, pointer);
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::pushRemote(arena_record* owner, void* pointer)
+{
+	// The payload is dead, so it links the stack. Pushes never take a lock
+	// and never touch the owner's free lists. The owner may have another configuration.
+	node* pushed = static_cast<node*>(pointer);
+	node* head = owner->remoteFrees->load(std::memory_order_relaxed);
+
+	do
+	{
+		pushed->next = head;
+	}
+	while (!owner->remoteFrees->compare_exchange_weak(head, pushed, std::memory_order_release, std::memory_order_relaxed));
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::freeRemoteBlocks()
+{
+	// Taking the whole stack at once leaves no ABA window for the pushers.
+	node* current = m_remoteFrees.exchange(nullptr, std::memory_order_acquire);
+
+	while (current)
+	{
+		node* next = current->next;
+
+		if (isSmallBlock(current))
+		{
+			freeSmall(current);
+		}
+		else
+		{
+			freeBlock(headerOf(current));
+		}
+
+		current = next;
+	}
+}
+
+template <class Config>
+void* BasicMemoryAllocator<Config>::allocateSmall(size_type n)
+{
+	int classIndex = n ? static_cast<int>((n - 1) / ALIGNMENT) : 0;
+	small_run* run = m_smallRuns[classIndex];
+
+	if (!run)
+	{
+		run = acquireRun((classIndex + 1) * ALIGNMENT, m_arenaId);
+
+		if (!run)
+		{
+			return nullptr;
+		}
+
+		m_smallRuns[classIndex] = run;
+		m_smallRunCount++;
+	}
+
+	// Runs on the class list always have a free slot.
+	int slot = findFreeSlot(run);
+	run->freeSlots[slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+	run->used++;
+	m_smallBlocks++;
+
+	if (run->used == run->slotCount)
+	{
+		m_smallRuns[classIndex] = run->next;
+
+		if (run->next)
+		{
+			run->next->previous = nullptr;
+		}
+
+		run->previous = nullptr;
+		run->next = m_fullRuns;
+
+		if (m_fullRuns)
+		{
+			m_fullRuns->previous = run;
+		}
+
+		m_fullRuns = run;
+	}
+
+	return reinterpret_cast<char*>(run) + slotsOffset() + slot * run->slotSize;
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::freeSmall(void* pointer)
+{
+	small_run* run = runOf(pointer);
+	std::uint64_t offset = static_cast<char*>(pointer) - reinterpret_cast<char*>(run) - slotsOffset();
+	// Exact for offsets below SMALL_RUN_SIZE, since the rounding error stays under 1 / slotSize.
+	size_type slot = static_cast<size_type>((offset * run->slotReciprocal) >> 32);
+	small_run*& classRuns = m_smallRuns[run->slotSize / ALIGNMENT - 1];
+
+	run->freeSlots[slot / 64] |= std::uint64_t(1) << (slot % 64);
+	m_smallBlocks--;
+
+	// A full run gets a free slot again and moves back to its class list.
+	if (run->used-- == run->slotCount)
+	{
+		if (run->previous)
+		{
+			run->previous->next = run->next;
+		}
+		else
+		{
+			m_fullRuns = run->next;
+		}
+
+		if (run->next)
+		{
+			run->next->previous = run->previous;
+		}
+
+		run->previous = nullptr;
+		run->next = classRuns;
+
+		if (classRuns)
+		{
+			classRuns->previous = run;
+		}
+
+		classRuns = run;
+	}
+
+	// An empty run goes back to the shared range unless it is the last one of its class.
+	if (!run->used && (run->previous || run->next))
+	{
+		if (run->previous)
+		{
+			run->previous->next = run->next;
+		}
+		else
+		{
+			classRuns = run->next;
+		}
+
+		if (run->next)
+		{
+			run->next->previous = run->previous;
+		}
+
+		releaseRun(run);
+		m_smallRunCount--;
+	}
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::releaseSmallRuns(small_run* run)
+{
+	while (run)
+	{
+		small_run* next = run->next;
+		releaseRun(run);
+		run = next;
+	}
+}
+
+template <class Config>
+std::uint64_t BasicMemoryAllocator<Config>::getFreeCells() const
+{
+	if (!stats_policy::enabled)
+	{
+		return 0;
+	}
+
+	std::lock_guard<lock_type> guard(m_lock);
+	return m_buddy ? m_buddy->getFreeBlocks() : m_freeBlocks + m_fastBlocks;
+}
+
+template <class Config>
+std::uint64_t BasicMemoryAllocator<Config>::getUsedCells() const
+{
+	if (!stats_policy::enabled)
+	{
+		return 0;
+	}
+
+	std::lock_guard<lock_type> guard(m_lock);
+	return m_buddy ? m_buddy->getUsedBlocks() : m_usedBlocks - m_fastBlocks;
+}
+
+template <class Config>
+std::uint64_t BasicMemoryAllocator<Config>::getUsedAmount() const
+{
+	if (!stats_policy::enabled)
+	{
+		return 0;
+	}
+
+	std::lock_guard<lock_type> guard(m_lock);
+	return m_buddy ? m_buddy->getUsedBytes() : m_usedBytes - m_fastBytes;
+}
+
+template <class Config>
+std::uint64_t BasicMemoryAllocator<Config>::getFreeAmount() const
+{
+	if (!stats_policy::enabled)
+	{
+		return 0;
+	}
+
+	std::lock_guard<lock_type> guard(m_lock);
+	return m_buddy ? m_buddy->getFreeBytes() : m_freeBytes + m_fastBytes;
+}
+
+template <class Config>
+int BasicMemoryAllocator<Config>::getChunkCount() const
+{
+	std::lock_guard<lock_type> guard(m_lock);
+	return m_buddy ? m_buddy->getRegionCount() : m_chunkCount;
+}
+
+template <class Config>
+size_type BasicMemoryAllocator<Config>::getReservedBytes() const
+{
+	std::lock_guard<lock_type> guard(m_lock);
+	return m_buddy ? m_buddy->getReservedBytes() : m_reservedBytes;
+}
+
+template <class Config>
+size_type BasicMemoryAllocator<Config>::getCommittedBytes() const
+{
+	std::lock_guard<lock_type> guard(m_lock);
+	return m_buddy ? m_buddy->getReservedBytes() : m_committedBytes;
+}
+
+template <class Config>
+size_type BasicMemoryAllocator<Config>::getSplitThreshold() const
+{
+	std::lock_guard<lock_type> guard(m_lock);
+	return m_minSplit;
+}
+
+template <class Config>
+std::uint32_t BasicMemoryAllocator<Config>::getSizeHistogram(int bin) const
+{
+	if (bin < 0 || bin >= SIZE_HISTOGRAM_BINS)
+	{
+		return 0;
+	}
+
+	std::lock_guard<lock_type> guard(m_lock);
+	return m_sizeHistogram[bin];
+}
+
+template <class Config>
+std::uint64_t BasicMemoryAllocator<Config>::getSmallBlockCount() const
+{
+	std::lock_guard<lock_type> guard(m_lock);
+	return m_smallBlocks;
+}
+
+template <class Config>
+size_type BasicMemoryAllocator<Config>::getSmallRunCount() const
+{
+	std::lock_guard<lock_type> guard(m_lock);
+	return m_smallRunCount;
+}
+
+template <class Config>
+std::uint64_t BasicMemoryAllocator<Config>::getLockAcquires() const
+{
+	return m_lock.acquires();
+}
+
+template <class Config>
+std::uint64_t BasicMemoryAllocator<Config>::getLockContentions() const
+{
+	return m_lock.contentions();
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::print() const
+{
+
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::init()
+{
+	for (int i = 0; i < SIZE_CLASS_COUNT; i++)
+	{
+		for (int j = 0; j < SUB_CLASS_COUNT; j++)
+		{
+			m_freeLists[i][j] = nullptr;
+		}
+
+		m_rovers[i] = nullptr;
+		m_nonEmptySubClasses[i] = 0;
+	}
+
+	for (int i = 0; i < FAST_BIN_COUNT; i++)
+	{
+		m_fastBins[i] = nullptr;
+		m_fastBinLengths[i] = 0;
+	}
+
+	m_fastBinSize = m_options.fastBinSize < FAST_BIN_COUNT * ALIGNMENT ? m_options.fastBinSize : FAST_BIN_COUNT * ALIGNMENT;
+	m_fastBlocks = 0;
+	m_fastBytes = 0;
+	m_nonEmptyClasses = 0;
+	m_top = nullptr;
+	m_topEnd = nullptr;
+	m_lastRemainder = nullptr;
+	m_minSplit = STATIC_MIN_SPLIT;
+	m_periodRequests = 0;
+
+	for (int i = 0; i < SIZE_HISTOGRAM_BINS; i++)
+	{
+		m_sizeHistogram[i] = 0;
+	}
+
+	m_largeFreeBlocks = nullptr;
+	m_bestFitThreshold = m_options.bestFitThreshold;
+
+	// Tree blocks must hold their tag, a tree node and their footer.
+	if (m_bestFitThreshold && m_bestFitThreshold < TAG_SIZE * 2 + sizeof(tree_node))
+	{
+		m_bestFitThreshold = TAG_SIZE * 2 + sizeof(tree_node);
+	}
+
+	if (m_engine == AllocationEngine::Buddy)
+	{
+		m_buddy.reset(new BuddyHeap(m_options));
+		return;
+	}
+
+	// The first chunk is acquired up front and counts as the retained free chunk.
+	addChunk(0);
+}
+
+template <class Config>
+node* BasicMemoryAllocator<Config>::addChunk(size_type n)
+{
+	size_type size = m_options.chunkSize;
+
+	if (size < n + CHUNK_OVERHEAD)
+	{
+		size = n + CHUNK_OVERHEAD;
+	}
+
+	if (size < CHUNK_OVERHEAD + MIN_BLOCK_SIZE)
+	{
+		size = CHUNK_OVERHEAD + MIN_BLOCK_SIZE;
+	}
+
+	size_type granularity = BLOCK_ALIGNMENT;
+
+	if (m_options.backing == ArenaBacking::Mapped)
+	{
+		granularity = m_options.hugePages ? HUGE_PAGE_SIZE : m_pageSize;
+	}
+
+	size = (size + granularity - 1) & ~(granularity - 1);
+
+	if (m_options.maxArenaSize && m_reservedBytes + size > m_options.maxArenaSize)
+	{
+		return nullptr;
+	}
+
+	void* memory;
+	char* base;
+
+	if (m_options.backing == ArenaBacking::Mapped)
+	{
+		memory = mapPages(size, HUGE_PAGE_SIZE, m_options.hugePages);
+		base = static_cast<char*>(memory);
+	}
+	else
+	{
+		// operator new[] only promises alignment for fundamental types, which is 8 on some targets.
+		memory = new (std::nothrow) char[size + BLOCK_ALIGNMENT];
+		base = reinterpret_cast<char*>((reinterpret_cast<size_type>(memory) + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1));
+	}
+
+	if (!memory)
+	{
+		return nullptr;
+	}
+
+	chunk* newChunk = reinterpret_cast<chunk*>(base);
+	newChunk->size = size;
+	newChunk->memory = memory;
+	newChunk->previous = nullptr;
+	newChunk->next = m_chunks;
+
+	if (m_chunks)
+	{
+		m_chunks->previous = newChunk;
+	}
+
+	m_chunks = newChunk;
+	m_chunkCount++;
+	m_freeChunkCount++;
+	m_reservedBytes += size;
+	m_committedBytes += size;
+
+	info_header* head = reinterpret_cast<info_header*>(base + CHUNK_HEADER_SIZE);
+	info_header* epilogue = reinterpret_cast<info_header*>(base + size) - 1;
+	size_type totalSizeLeft = size - CHUNK_OVERHEAD;
+
+	epilogue->m_tag = 0;
+	head->m_tag = FIRST_BIT;
+	writeFree(head, totalSizeLeft);
+
+	// The newest chunk holds the wilderness; the old one goes to the lists like any free block.
+	info_header* oldTop = m_top;
+
+	m_top = nullptr;
+	m_topEnd = epilogue;
+
+	if (oldTop)
+	{
+		addNode(nodeOf(oldTop));
+	}
+
+	node* freeNode = nodeOf(head);
+	addNode(freeNode);
+
+	m_freeBlocks++;
+	m_freeBytes += totalSizeLeft;
+
+	return freeNode;
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::releaseChunk(chunk* released)
+{
+	if (released->previous)
+	{
+		released->previous->next = released->next;
+	}
+	else
+	{
+		m_chunks = released->next;
+	}
+
+	if (released->next)
+	{
+		released->next->previous = released->previous;
+	}
+
+	if (reinterpret_cast<char*>(m_topEnd) == reinterpret_cast<char*>(released) + released->size - TAG_SIZE)
+	{
+		m_topEnd = nullptr;
+	}
+
+	m_chunkCount--;
+	m_reservedBytes -= released->size;
+	m_committedBytes -= released->size;
+
+	if (m_options.backing == ArenaBacking::Mapped)
+	{
+		unmapPages(released->memory, released->size);
+	}
+	else
+	{
+		delete [] static_cast<char*>(released->memory);
+	}
+}
+
+template <class Config>
+size_type BasicMemoryAllocator<Config>::blockSize(size_type n)
+{
+	size_type size = (n + TAG_SIZE + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1);
+
+	return size < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : size;
+}
+
+template <class Config>
+size_type BasicMemoryAllocator<Config>::usableSize(const void* pointer)
+{
+	if (isSmallBlock(pointer))
+	{
+		return runOf(pointer)->slotSize;
+	}
+
+	// Called without the lock by front ends such as ThreadCachingAllocator.
+	std::uint64_t tag = (static_cast<const info_header*>(pointer) - 1)->sharedTag();
+
+	return static_cast<size_type>(tag & ~(TAG_FLAGS | ARENA_BITS)) - TAG_SIZE;
+}
+
+template <class Config>
+bool BasicMemoryAllocator<Config>::purgeRange(info_header* header, char*& begin, char*& end) const
+{
+	// The header, the list or tree node and the footer stay resident; only whole pages in between go.
+	size_type first = reinterpret_cast<size_type>(nodeOf(header)) + sizeof(tree_node);
+	size_type last = reinterpret_cast<size_type>(footerOf(header));
+
+	begin = reinterpret_cast<char*>((first + m_pageSize - 1) & ~(m_pageSize - 1));
+	end = reinterpret_cast<char*>(last & ~(m_pageSize - 1));
+
+	return end > begin;
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::purgeBlock(info_header* header)
+{
+	char* begin;
+	char* end;
+
+	if (purgeRange(header, begin, end))
+	{
+		purgePages(begin, end - begin);
+		m_committedBytes -= end - begin;
+		header->m_tag |= PURGED_BIT;
+	}
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::recommitBlock(info_header* header)
+{
+	char* begin;
+	char* end;
+
+	if (purgeRange(header, begin, end))
+	{
+		recommitPages(begin, end - begin);
+		m_committedBytes += end - begin;
+	}
+
+	header->m_tag &= ~PURGED_BIT;
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::recordRequest(size_type size)
+{
+	size_type bin = size / ALIGNMENT;
+
+	m_sizeHistogram[bin < SIZE_HISTOGRAM_BINS ? bin : SIZE_HISTOGRAM_BINS - 1]++;
+
+	if (++m_periodRequests < HISTOGRAM_PERIOD)
+	{
+		return;
+	}
+
+	// Keeping a remainder of r bytes as slack wastes all r bytes. Splitting it off wastes
+	// r only when no request fits it, r * (1 - F(r)) on average with F(r) the share of
+	// recent requests of at most r bytes, and adds a free block to the lists, charged
+	// as MIN_BLOCK_SIZE bytes. Splitting wins once r * F(r) > MIN_BLOCK_SIZE, and since
+	// r * F(r) only grows with r the threshold is the first remainder where it does.
+	// Never below the static rule, which already drops remainders too small to use.
+	std::uint64_t total = 0;
+
+	for (int i = 0; i < SIZE_HISTOGRAM_BINS; i++)
+	{
+		total += m_sizeHistogram[i];
+	}
+
+	std::uint64_t fitting = 0;
+	size_type threshold = STATIC_MIN_SPLIT;
+
+	for (int bin = 0; bin < SIZE_HISTOGRAM_BINS; bin++)
+	{
+		fitting += m_sizeHistogram[bin];
+
+		if (bin * ALIGNMENT * fitting > MIN_BLOCK_SIZE * total)
+		{
+			threshold = bin * ALIGNMENT > STATIC_MIN_SPLIT ? bin * ALIGNMENT : STATIC_MIN_SPLIT;
+			break;
+		}
+	}
+
+	m_minSplit = threshold;
+
+	for (int i = 0; i < SIZE_HISTOGRAM_BINS; i++)
+	{
+		m_sizeHistogram[i] >>= 1;
+	}
+
+	m_periodRequests = 0;
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::mapping(size_type amount, int& sizeClassIndex, int& subClassIndex)
+{
+	sizeClassIndex = findHighestBit(amount);
+
+	// The bits right below the leading one pick the linear subdivision of the class.
+	if (sizeClassIndex >= SUB_CLASS_LOG2)
+	{
+		subClassIndex = static_cast<int>(amount >> (sizeClassIndex - SUB_CLASS_LOG2)) - SUB_CLASS_COUNT;
+	}
+	else
+	{
+		subClassIndex = static_cast<int>(amount << (SUB_CLASS_LOG2 - sizeClassIndex)) - SUB_CLASS_COUNT;
+	}
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::binIndex(size_type amount, int& sizeClassIndex, int& subClassIndex) const
+{
+	mapping(amount, sizeClassIndex, subClassIndex);
+
+	if (!Config::search_policy::tlsf(m_engine))
+	{
+		subClassIndex = 0;
+	}
+}
+
+template <class Config>
+node* BasicMemoryAllocator<Config>::findFit(size_type n)
+{
+	if (m_bestFitThreshold && n >= m_bestFitThreshold)
+	{
+		node* result = reinterpret_cast<node*>(treeFindFit(m_largeFreeBlocks, n));
+
+		if (!result && m_top && m_top->size() >= n)
+		{
+			result = nodeOf(m_top);
+		}
+
+		return result;
+	}
+
+	node* result = Config::search_policy::tlsf(m_engine) ? findTlsfFit(n) : findSegregatedFit(n);
+
+	// Every tree block is bigger than n, so the smallest one is the best fit.
+	if (!result && m_largeFreeBlocks)
+	{
+		result = reinterpret_cast<node*>(treeFindFit(m_largeFreeBlocks, n));
+	}
+
+	// Only what the lists cannot serve is cut from the wilderness.
+	if (!result && m_top && m_top->size() >= n)
+	{
+		result = nodeOf(m_top);
+	}
+
+	return result;
+}
+
+template <class Config>
+node* BasicMemoryAllocator<Config>::findSegregatedFit(size_type n)
+{
+	int sizeClassIndex = findHighestBit(n);
+
+	// Blocks in the request's own class may still be too small, so that one list is scanned.
+	if (m_nonEmptyClasses & (std::uint64_t(1) << sizeClassIndex))
+	{
+		node* start = m_options.freeListPolicy == FreeListPolicy::NextFit && m_rovers[sizeClassIndex] ?
+			m_rovers[sizeClassIndex] : m_freeLists[sizeClassIndex][0];
+		node* currentNode = start;
+
+		// A next-fit scan wraps around to the head and stops where it started.
+		do
+		{
+			if (headerOf(currentNode)->size() >= n)
+			{
+				if (m_options.freeListPolicy == FreeListPolicy::NextFit)
+				{
+					m_rovers[sizeClassIndex] = currentNode;
+				}
+
+				return currentNode;
+			}
+
+			currentNode = currentNode->next ? currentNode->next : m_freeLists[sizeClassIndex][0];
+		}
+		while (currentNode != start);
+	}
+
+	if (sizeClassIndex + 1 >= SIZE_CLASS_COUNT)
+	{
+		return nullptr;
+	}
+
+	// Every block in a higher class fits, so the head of the smallest one is taken.
+	std::uint64_t largerClasses = m_nonEmptyClasses & (~std::uint64_t(0) << (sizeClassIndex + 1));
+
+	if (!largerClasses)
+	{
+		return nullptr;
+	}
+
+	sizeClassIndex = findLowestBit(largerClasses);
+
+	if (m_options.freeListPolicy != FreeListPolicy::NextFit)
+	{
+		return m_freeLists[sizeClassIndex][0];
+	}
+
+	if (!m_rovers[sizeClassIndex])
+	{
+		m_rovers[sizeClassIndex] = m_freeLists[sizeClassIndex][0];
+	}
+
+	return m_rovers[sizeClassIndex];
+}
+
+template <class Config>
+node* BasicMemoryAllocator<Config>::findTlsfFit(size_type n)
+{
+	// Rounding the request up to the next list boundary makes every block of the found list fit,
+	// so no list is ever walked.
+	int sizeClassIndex = findHighestBit(n);
+
+	if (sizeClassIndex > SUB_CLASS_LOG2)
+	{
+		n += (size_type(1) << (sizeClassIndex - SUB_CLASS_LOG2)) - 1;
+	}
+
+	int subClassIndex;
+	mapping(n, sizeClassIndex, subClassIndex);
+
+	std::uint32_t subClasses = m_nonEmptySubClasses[sizeClassIndex] & (~std::uint32_t(0) << subClassIndex);
+
+	if (!subClasses)
+	{
+		if (sizeClassIndex + 1 >= SIZE_CLASS_COUNT)
+		{
+			return nullptr;
+		}
+
+		std::uint64_t largerClasses = m_nonEmptyClasses & (~std::uint64_t(0) << (sizeClassIndex + 1));
+
+		if (!largerClasses)
+		{
+			return nullptr;
+		}
+
+		sizeClassIndex = findLowestBit(largerClasses);
+		subClasses = m_nonEmptySubClasses[sizeClassIndex];
+	}
+
+	return m_freeLists[sizeClassIndex][findLowestBit(subClasses)];
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::addNode(node* freed)
+{
+	// A free block reaching the end of the newest chunk is the wilderness, whatever freed it.
+	if (nextBlock(headerOf(freed)) == m_topEnd)
+	{
+		m_top = headerOf(freed);
+		return;
+	}
+
+	if (m_bestFitThreshold && headerOf(freed)->size() >= m_bestFitThreshold)
+	{
+		treeInsert(m_largeFreeBlocks, reinterpret_cast<tree_node*>(freed));
+		return;
+	}
+
+	int sizeClassIndex;
+	int subClassIndex;
+	binIndex(headerOf(freed)->size(), sizeClassIndex, subClassIndex);
+
+	node* previous = nullptr;
+	node* next = m_freeLists[sizeClassIndex][subClassIndex];
+
+	if (m_options.freeListPolicy == FreeListPolicy::AddressOrdered)
+	{
+		while (next && std::less<node*>()(next, freed))
+		{
+			previous = next;
+			next = next->next;
+		}
+	}
+
+	freed->previous = previous;
+	freed->next = next;
+
+	if (next)
+	{
+		next->previous = freed;
+	}
+
+	if (previous)
+	{
+		previous->next = freed;
+	}
+	else
+	{
+		m_freeLists[sizeClassIndex][subClassIndex] = freed;
+	}
+
+	m_nonEmptySubClasses[sizeClassIndex] |= std::uint32_t(1) << subClassIndex;
+	m_nonEmptyClasses |= std::uint64_t(1) << sizeClassIndex;
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::removeNode(node* used)
+{
+	if (headerOf(used) == m_lastRemainder)
+	{
+		m_lastRemainder = nullptr;
+	}
+
+	if (isPending(headerOf(used)))
+	{
+		if (used->previous)
+		{
+			used->previous->next = used->next;
+		}
+		else
+		{
+			m_pendingBlocks = used->next;
+		}
+
+		if (used->next)
+		{
+			used->next->previous = used->previous;
+		}
+
+		m_pendingFrees--;
+		return;
+	}
+
+	if (headerOf(used) == m_top)
+	{
+		m_top = nullptr;
+		return;
+	}
+
+	if (m_bestFitThreshold && headerOf(used)->size() >= m_bestFitThreshold)
+	{
+		treeRemove(m_largeFreeBlocks, reinterpret_cast<tree_node*>(used));
+		return;
+	}
+
+	int sizeClassIndex;
+	int subClassIndex;
+	binIndex(headerOf(used)->size(), sizeClassIndex, subClassIndex);
+
+	// The rover moves on past a block leaving its list; off the end it restarts at the head.
+	if (m_rovers[sizeClassIndex] == used)
+	{
+		m_rovers[sizeClassIndex] = used->next;
+	}
+
+	if (used->previous)
+	{
+		used->previous->next = used->next;
+	}
+	else
+	{
+		m_freeLists[sizeClassIndex][subClassIndex] = used->next;
+
+		if (!used->next)
+		{
+			m_nonEmptySubClasses[sizeClassIndex] &= ~(std::uint32_t(1) << subClassIndex);
+
+			if (!m_nonEmptySubClasses[sizeClassIndex])
+			{
+				m_nonEmptyClasses &= ~(std::uint64_t(1) << sizeClassIndex);
+			}
+		}
+	}
+
+	if (used->next)
+	{
+		used->next->previous = used->previous;
+	}
+}
+
+template <class Config>
+bool BasicMemoryAllocator<Config>::verifyHeap() const
+{
+	std::lock_guard<lock_type> guard(m_lock);
+	return checkHeap();
+}
+
+template <class Config>
+bool BasicMemoryAllocator<Config>::checkHeap() const
+{
+	bool result = true;
+	heap_totals totals = {};
+	std::uint64_t listedBlocks = 0;
+	int chunkCount = 0;
+
+	for (const chunk* currentChunk = m_chunks; currentChunk; currentChunk = currentChunk->next)
+	{
+		if (currentChunk->next && currentChunk->next->previous != currentChunk)
+		{
+			return report("chunk list links disagree", currentChunk);
+		}
+
+		result = verifyChunk(currentChunk, totals) && result;
+		chunkCount++;
+	}
+
+	if (chunkCount != m_chunkCount)
+	{
+		result = report("chunk count does not match the chunk list", m_chunks);
+	}
+
+	if (totals.freeChunks != m_freeChunkCount)
+	{
+		result = report("fully free chunk count does not match the heap", m_chunks);
+	}
+
+	if (stats_policy::enabled && (totals.freeBlocks != m_freeBlocks || totals.usedBlocks != m_usedBlocks ||
+		totals.freeBytes != m_freeBytes || totals.usedBytes != m_usedBytes))
+	{
+		result = report("occupancy counters do not match the heap", m_chunks);
+	}
+
+	if (!verifyFreeLists(listedBlocks))
+	{
+		return false;
+	}
+
+	if (listedBlocks != totals.freeBlocks)
+	{
+		result = report("free lists and heap disagree on the number of free blocks", m_chunks);
+	}
+
+	result = verifyFastBins() && result;
+
+	result = verifySmallRuns() && result;
+
+	if (m_buddy)
+	{
+		const char* message;
+		const void* address;
+
+		if (!m_buddy->verify(message, address))
+		{
+			result = report(message, address);
+		}
+	}
+
+	return result;
+}
+
+template <class Config>
+void BasicMemoryAllocator<Config>::setVerifyCallback(VerifyCallback callback, void* context)
+{
+	m_verifyCallback = callback;
+	m_verifyContext = context;
+}
+
+template <class Config>
+bool BasicMemoryAllocator<Config>::report(const char* message, const void* address) const
+{
+	if (m_verifyCallback)
+	{
+		m_verifyCallback(message, address, m_verifyContext);
+	}
+	else
+	{
+		assert(!"MemoryAllocator heap verification failed");
+	}
+
+	return false;
+}
+
+template <class Config>
+bool BasicMemoryAllocator<Config>::verifyChunk(const chunk* currentChunk, heap_totals& totals) const
+{
+	const char* c_chunk = reinterpret_cast<const char*>(currentChunk);
+	const char* c_epilogue = c_chunk + currentChunk->size - TAG_SIZE;
+	const char* c_currentHeader = c_chunk + CHUNK_HEADER_SIZE;
+	bool previousFree = false;
+	bool previousPending = false;
+	int blocks = 0;
+
+	while (c_currentHeader != c_epilogue)
+	{
+		const info_header* currentHeader = reinterpret_cast<const info_header*>(c_currentHeader);
+		size_type size = currentHeader->size();
+
+		if (size < MIN_BLOCK_SIZE || size > size_type(c_epilogue - c_currentHeader))
+		{
+			return report("block size runs outside its chunk", currentHeader);
+		}
+
+		if (currentHeader->isFirst() != (blocks == 0))
+		{
+			return report("first-in-chunk flag is wrong", currentHeader);
+		}
+
+		if (currentHeader->isPrevFree() != previousFree)
+		{
+			return report("previous-free flag disagrees with the block to the left", currentHeader);
+		}
+
+		if (currentHeader->isFree())
+		{
+			const info_header* end = reinterpret_cast<const info_header*>(c_currentHeader + size) - 1;
+			bool pending = (end->m_tag & PENDING_BIT) != 0;
+
+			if ((end->m_tag & ~PENDING_BIT) != (size | FREE_BIT))
+			{
+				return report("block header and footer disagree", currentHeader);
+			}
+
+			// Deferred frees wait for a pass; filed blocks are always merged.
+			if (previousFree && !previousPending && !pending)
+			{
+				return report("two adjacent free blocks were not coalesced", currentHeader);
+			}
+
+			previousPending = pending;
+
+			totals.freeBlocks++;
+			totals.freeBytes += size;
+		}
+		else if (currentHeader->isPurged())
+		{
+			return report("used block is marked as purged", currentHeader);
+		}
+		else if (currentHeader->arena() != m_arenaId)
+		{
+			return report("used block is tagged with another arena", currentHeader);
+		}
+		else
+		{
+			totals.usedBlocks++;
+			totals.usedBytes += size;
+		}
+
+		previousFree = currentHeader->isFree();
+		blocks++;
+		c_currentHeader += size;
+	}
+
+	const info_header* epilogue = reinterpret_cast<const info_header*>(c_epilogue);
+
+	if (epilogue->size() != 0 || epilogue->isFree() || epilogue->isPrevFree() != previousFree)
+	{
+		return report("chunk epilogue is damaged", epilogue);
+	}
+
+	// A pending block is only counted once a pass files it.
+	if (blocks == 1 && previousFree && !previousPending)
+	{
+		totals.freeChunks++;
+	}
+
+	return true;
+}
+
+template <class Config>
+bool BasicMemoryAllocator<Config>::verifyFreeLists(std::uint64_t& listedBlocks) const
+{
+	for (int i = 0; i < SIZE_CLASS_COUNT; i++)
+	{
+		if (!m_nonEmptySubClasses[i] != !(m_nonEmptyClasses & (std::uint64_t(1) << i)))
+		{
+			return report("size class bitmap disagrees with its sub-class bitmap", &m_freeLists[i]);
+		}
+
+		bool roverListed = !m_rovers[i];
+
+		for (int j = 0; j < SUB_CLASS_COUNT; j++)
+		{
+			const node* current = m_freeLists[i][j];
+			const node* previous = nullptr;
+
+			if (!current != !(m_nonEmptySubClasses[i] & (std::uint32_t(1) << j)))
+			{
+				return report("sub-class bitmap disagrees with its free list", &m_freeLists[i][j]);
+			}
+
+			while (current)
+			{
+				const info_header* header = reinterpret_cast<const info_header*>(current) - 1;
+				int sizeClassIndex;
+				int subClassIndex;
+
+				if (current->previous != previous)
+				{
+					return report("free list back link is broken", current);
+				}
+
+				if (m_options.freeListPolicy == FreeListPolicy::AddressOrdered && previous &&
+					!std::less<const node*>()(previous, current))
+				{
+					return report("address ordered free list is out of order", current);
+				}
+
+				roverListed |= current == m_rovers[i] && j == 0;
+
+				if (!header->isFree())
+				{
+					return report("used block found in a free list", header);
+				}
+
+				if (isPending(header))
+				{
+					return report("pending block found in a size class list", header);
+				}
+
+				if (header == m_top || nextBlock(const_cast<info_header*>(header)) == m_topEnd)
+				{
+					return report("wilderness block found in a size class list", header);
+				}
+
+				if (m_bestFitThreshold && header->size() >= m_bestFitThreshold)
+				{
+					return report("large free block found in a size class list", header);
+				}
+
+				binIndex(header->size(), sizeClassIndex, subClassIndex);
+
+				if (sizeClassIndex != i || subClassIndex != j)
+				{
+					return report("free block is filed under the wrong size class", header);
+				}
+
+				listedBlocks++;
+				previous = current;
+				current = current->next;
+			}
+		}
+
+		if (!roverListed)
+		{
+			return report("next-fit rover points outside its free list", m_rovers[i]);
+		}
+	}
+
+	const tree_node* bad = nullptr;
+	std::uint64_t treeBlocks = 0;
+
+	if (!treeVerify(m_largeFreeBlocks, m_bestFitThreshold, treeBlocks, bad))
+	{
+		return report("best-fit tree is broken or holds a used or undersized block", bad);
+	}
+
+	listedBlocks += treeBlocks;
+
+	std::uint64_t pendingBlocks = 0;
+	const node* previous = nullptr;
+
+	for (const node* current = m_pendingBlocks; current; previous = current, current = current->next)
+	{
+		const info_header* header = reinterpret_cast<const info_header*>(current) - 1;
+
+		if (current->previous != previous)
+		{
+			return report("pending list back link is broken", current);
+		}
+
+		if (!header->isFree() || !isPending(header))
+		{
+			return report("pending list holds a used or filed block", header);
+		}
+
+		pendingBlocks++;
+	}
+
+	if (pendingBlocks != m_pendingFrees)
+	{
+		return report("pending free count does not match the pending list", m_pendingBlocks);
+	}
+
+	listedBlocks += pendingBlocks;
+
+	if (m_lastRemainder && (!m_lastRemainder->isFree() || isPending(m_lastRemainder)))
+	{
+		return report("last remainder is used or pending", m_lastRemainder);
+	}
+
+	if (m_top)
+	{
+		if (!m_top->isFree() || isPending(m_top) || nextBlock(m_top) != m_topEnd)
+		{
+			return report("wilderness block is used, pending or not at the end of its chunk", m_top);
+		}
+
+		listedBlocks++;
+	}
+
+	return true;
+}
+
+template <class Config>
+bool BasicMemoryAllocator<Config>::verifyFastBins() const
+{
+	std::uint64_t blocks = 0;
+	std::uint64_t bytes = 0;
+
+	for (int i = 0; i < FAST_BIN_COUNT; i++)
+	{
+		size_type length = 0;
+
+		for (const node* current = m_fastBins[i]; current; current = current->next)
+		{
+			const info_header* header = reinterpret_cast<const info_header*>(current) - 1;
+
+			if (header->isFree() || header->arena() != m_arenaId ||
+				header->size() != (i + 1) * ALIGNMENT)
+			{
+				return report("fast bin holds a free, foreign or wrongly sized block", header);
+			}
+
+			length++;
+			bytes += header->size();
+		}
+
+		if (length != m_fastBinLengths[i])
+		{
+			return report("fast bin length does not match its list", &m_fastBins[i]);
+		}
+
+		blocks += length;
+	}
+
+	if (blocks != m_fastBlocks || bytes != m_fastBytes)
+	{
+		return report("fast bin counters do not match the bins", m_fastBins);
+	}
+
+	return true;
+}
+
+inline int countSlots(const small_run* run)
+{
+	int result = 0;
+
+	for (int i = 0; i < SMALL_BITMAP_WORDS; i++)
+	{
+		for (std::uint64_t word = run->freeSlots[i]; word; word &= word - 1)
+		{
+			result++;
+		}
+	}
+
+	return result;
+}
+
+template <class Config>
+bool BasicMemoryAllocator<Config>::verifySmallRuns() const
+{
+	std::uint64_t usedSlots = 0;
+	size_type runs = 0;
+
+	for (int i = 0; i <= SMALL_CLASS_COUNT; i++)
+	{
+		// The last pass walks the full runs, which may be of any class.
+		const small_run* current = i < SMALL_CLASS_COUNT ? m_smallRuns[i] : m_fullRuns;
+		const small_run* previous = nullptr;
+
+		for (; current; previous = current, current = current->next)
+		{
+			if (current->previous != previous)
+			{
+				return report("small run list back link is broken", current);
+			}
+
+			if (current->arena != m_arenaId || (i < SMALL_CLASS_COUNT && current->slotSize != (i + 1) * ALIGNMENT))
+			{
+				return report("small run is filed under the wrong arena or class", current);
+			}
+
+			if (current->used + countSlots(current) != current->slotCount)
+			{
+				return report("small run bitmap disagrees with its used count", current);
+			}
+
+			if ((i < SMALL_CLASS_COUNT) == (current->used == current->slotCount))
+			{
+				return report("small run is on the wrong list for its occupancy", current);
+			}
+
+			usedSlots += current->used;
+			runs++;
+		}
+	}
+
+	if (usedSlots != m_smallBlocks || runs != m_smallRunCount)
+	{
+		return report("small block counters do not match the runs", m_fullRuns);
+	}
+
+	return true;
+}
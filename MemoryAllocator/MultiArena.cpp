@@ -0,0 +1,114 @@
+#include "MultiArena.h"
+#include <cassert>
+#include <functional>
+#include <thread>
+
+static MemoryAllocatorOptions lockedOptions(MemoryAllocatorOptions options)
+{
+	options = MemoryAllocatorOptions::tagged(options);
+
+	if (options.locking == LockingPolicy::None)
+	{
+		options.locking = LockingPolicy::Spin;
+	}
+
+	return options;
+}
+
+MultiArenaAllocator::MultiArenaAllocator(int arenaCount, const MemoryAllocatorOptions& options)
+{
+	MemoryAllocatorOptions arenaOptions = lockedOptions(options);
+
+	if (arenaCount < 1)
+	{
+		arenaCount = 1;
+	}
+
+	for (int i = 0; i < arenaCount; i++)
+	{
+		m_arenas.push_back(std::unique_ptr<MemoryAllocator>(new MemoryAllocator(arenaOptions)));
+	}
+}
+
+void* MultiArenaAllocator::allocate(size_type n)
+{
+	int count = getArenaCount();
+	int home = homeArena();
+	void* result;
+	bool busy = false;
+
+	// A full or capped arena misses, so the request moves on to the next one.
+	for (int i = 0; i < count; i++)
+	{
+		if (!m_arenas[(home + i) % count]->tryAllocate(n, result))
+		{
+			busy = true;
+		}
+		else if (result)
+		{
+			return result;
+		}
+	}
+
+	if (!busy)
+	{
+		return nullptr;
+	}
+
+	// Some arenas were busy, so wait for each in turn, our own first.
+	for (int i = 0; i < count; i++)
+	{
+		result = m_arenas[(home + i) % count]->allocate(n);
+
+		if (result)
+		{
+			return result;
+		}
+	}
+
+	return nullptr;
+}
+
+void MultiArenaAllocator::deallocate(void* pointer)
+{
+	if (!pointer)
+	{
+		return;
+	}
+
+	// Arenas that found the registry full tag their blocks with no owner.
+	MemoryAllocator* owner = MemoryAllocator::ownerOf(pointer);
+	assert(owner && "block has no owning arena");
+
+	if (owner)
+	{
+		owner->deallocate(pointer);
+	}
+}
+
+int MultiArenaAllocator::getArenaCount() const
+{
+	return static_cast<int>(m_arenas.size());
+}
+
+const MemoryAllocator& MultiArenaAllocator::getArena(int index) const
+{
+	return *m_arenas[index];
+}
+
+std::uint64_t MultiArenaAllocator::getUsedCells() const
+{
+	std::uint64_t result = 0;
+
+	for (size_t i = 0; i < m_arenas.size(); i++)
+	{
+		result += m_arenas[i]->getUsedCells();
+	}
+
+	return result;
+}
+
+int MultiArenaAllocator::homeArena() const
+{
+	return static_cast<int>(std::hash<std::thread::id>()(std::this_thread::get_id()) % m_arenas.size());
+}
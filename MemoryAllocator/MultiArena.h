@@ -0,0 +1,32 @@
+#pragma once
+#include "MemoryAllocator.h"
+#include <memory>
+#include <vector>
+
+// Thread-safe front end over K locked arenas. A thread starts at the arena its id
+// hashes to and falls over to the next one whenever the lock is held, so threads
+// spread out under contention the way glibc steals arenas. Blocks are freed
+// through the arena that owns them, whichever thread frees them.
+class MultiArenaAllocator
+{
+public:
+
+	// Options without a locking policy get spin locks. Frees find their arena through the
+	// block tag, so the Buddy engine is replaced by SegregatedFit.
+	explicit MultiArenaAllocator(int arenaCount, const MemoryAllocatorOptions& = MemoryAllocatorOptions());
+	MultiArenaAllocator(const MultiArenaAllocator&) = delete;
+	MultiArenaAllocator& operator=(const MultiArenaAllocator&) = delete;
+
+	void* allocate(size_type);
+	void deallocate(void*);
+
+	int getArenaCount() const;
+	// Per-arena stats and lock counters, for sizing K.
+	const MemoryAllocator& getArena(int) const;
+	std::uint64_t getUsedCells() const;
+
+private:
+	std::vector<std::unique_ptr<MemoryAllocator>> m_arenas;
+
+	int homeArena() const;
+};
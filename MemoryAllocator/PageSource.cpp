@@ -0,0 +1,134 @@
+#include "PageSource.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+std::size_t systemPageSize()
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwPageSize;
+#else
+	return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+#if defined(_WIN32)
+
+void* mapPages(std::size_t size, std::size_t alignment, bool)
+{
+	// Reserve an oversized range to find an aligned address, then map exactly there.
+	// Another thread may grab the address in between, so this is retried a few times.
+	for (int attempt = 0; attempt < 8; attempt++)
+	{
+		char* probe = static_cast<char*>(VirtualAlloc(nullptr, size + alignment, MEM_RESERVE, PAGE_NOACCESS));
+
+		if (!probe)
+		{
+			return nullptr;
+		}
+
+		char* aligned = reinterpret_cast<char*>((reinterpret_cast<std::size_t>(probe) + alignment - 1) & ~(alignment - 1));
+		VirtualFree(probe, 0, MEM_RELEASE);
+
+		void* result = VirtualAlloc(aligned, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+		if (result)
+		{
+			return result;
+		}
+	}
+
+	return nullptr;
+}
+
+void unmapPages(void* address, std::size_t)
+{
+	VirtualFree(address, 0, MEM_RELEASE);
+}
+
+void* reservePages(std::size_t size)
+{
+	return VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+void purgePages(void* address, std::size_t size)
+{
+	VirtualFree(address, size, MEM_DECOMMIT);
+}
+
+void recommitPages(void* address, std::size_t size)
+{
+	VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE);
+}
+
+#else
+
+void* mapPages(std::size_t size, std::size_t alignment, bool hugePages)
+{
+	std::size_t pageSize = systemPageSize();
+	std::size_t slack = alignment > pageSize ? alignment - pageSize : 0;
+
+	void* mapped = mmap(nullptr, size + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (mapped == MAP_FAILED)
+	{
+		return nullptr;
+	}
+
+	// Trim the unaligned head and whatever is left of the slack after the range.
+	char* begin = static_cast<char*>(mapped);
+	char* aligned = reinterpret_cast<char*>((reinterpret_cast<std::size_t>(begin) + alignment - 1) & ~(alignment - 1));
+	char* end = begin + size + slack;
+
+	if (aligned > begin)
+	{
+		munmap(begin, aligned - begin);
+	}
+
+	if (end > aligned + size)
+	{
+		munmap(aligned + size, end - (aligned + size));
+	}
+
+#if defined(MADV_HUGEPAGE)
+	if (hugePages)
+	{
+		madvise(aligned, size, MADV_HUGEPAGE);
+	}
+#else
+	(void)hugePages;
+#endif
+
+	return aligned;
+}
+
+void unmapPages(void* address, std::size_t size)
+{
+	munmap(address, size);
+}
+
+void* reservePages(std::size_t size)
+{
+	// Untouched anonymous pages cost nothing, so reserving is just a lazy mapping.
+	void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	return mapped == MAP_FAILED ? nullptr : mapped;
+}
+
+void purgePages(void* address, std::size_t size)
+{
+	madvise(address, size, MADV_DONTNEED);
+}
+
+void recommitPages(void*, std::size_t)
+{
+	// Purged anonymous pages fault back in zero filled on first touch.
+}
+
+#endif
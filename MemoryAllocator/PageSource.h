@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+
+// Thin wrapper over the OS virtual memory calls used by mapped arenas.
+
+const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+std::size_t systemPageSize();
+
+// Maps size bytes of read/write memory aligned to alignment (a power of two).
+// Returns nullptr when the OS refuses.
+void* mapPages(std::size_t size, std::size_t alignment, bool hugePages);
+void unmapPages(void* address, std::size_t size);
+
+// Reserves address space without committing it; ranges are committed with
+// recommitPages before use and given back with unmapPages.
+void* reservePages(std::size_t size);
+
+// Gives the physical pages of a page-aligned range back to the OS while keeping
+// the range mapped. The range must be recommitted before it is touched again.
+void purgePages(void* address, std::size_t size);
+void recommitPages(void* address, std::size_t size);
@@ -0,0 +1,253 @@
+#pragma once
+#include "MemoryAllocator.h"
+#include <new>
+#include <utility>
+
+// Start of every slab. Slots follow it back to back; free ones are linked through
+// their first word, so objects carry no header of their own.
+struct pool_slab
+{
+	pool_slab* previous;
+	pool_slab* next;
+	void* freeSlots;
+	size_type used;
+	// Slots past this index were never handed out and are not on the free list yet.
+	size_type carved;
+};
+
+// Fixed-size object pool for one type. Slabs of BlocksPerSlab slots are carved out of a
+// parent MemoryAllocator, aligned to their own rounded-up size so that a slot finds its
+// slab by masking its address. Fully free slabs go back to the parent, except one that
+// is kept to avoid churn at a slab boundary.
+template <typename T, size_type BlocksPerSlab = 64>
+class PoolAllocator
+{
+	static_assert(BlocksPerSlab > 0, "a slab needs at least one slot");
+
+public:
+
+	static const size_type SLOT_ALIGNMENT = alignof(T) > alignof(void*) ? alignof(T) : alignof(void*);
+	static const size_type SLOT_SIZE = (sizeof(T) + SLOT_ALIGNMENT - 1) & ~(SLOT_ALIGNMENT - 1);
+	static const size_type SLOTS_OFFSET = (sizeof(pool_slab) + SLOT_ALIGNMENT - 1) & ~(SLOT_ALIGNMENT - 1);
+	static const size_type SLAB_SIZE = SLOTS_OFFSET + SLOT_SIZE * BlocksPerSlab;
+
+	explicit PoolAllocator(MemoryAllocator& parent)
+		: m_parent(parent), m_partial(nullptr), m_emptySlab(nullptr), m_full(nullptr), m_slabCount(0), m_usedBlocks(0)
+	{}
+
+	PoolAllocator(const PoolAllocator&) = delete;
+	PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+	// Live objects are not destroyed; their memory goes back to the parent with the slabs.
+	~PoolAllocator()
+	{
+		releaseList(m_partial);
+		releaseList(m_full);
+
+		if (m_emptySlab)
+		{
+			m_parent.deallocate(m_emptySlab);
+		}
+	}
+
+	// Uninitialized storage for one T.
+	T* allocate()
+	{
+		pool_slab* slab = m_partial;
+
+		if (!slab)
+		{
+			slab = takeSlab();
+
+			if (!slab)
+			{
+				return nullptr;
+			}
+		}
+
+		void* slot = slab->freeSlots;
+
+		if (slot)
+		{
+			slab->freeSlots = *static_cast<void**>(slot);
+		}
+		else
+		{
+			slot = reinterpret_cast<char*>(slab) + SLOTS_OFFSET + slab->carved * SLOT_SIZE;
+			slab->carved++;
+		}
+
+		slab->used++;
+		m_usedBlocks++;
+
+		if (slab->used == BlocksPerSlab)
+		{
+			unlink(m_partial, slab);
+			link(m_full, slab);
+		}
+
+		return static_cast<T*>(slot);
+	}
+
+	void deallocate(T* pointer)
+	{
+		if (!pointer)
+		{
+			return;
+		}
+
+		pool_slab* slab = slabOf(pointer);
+
+		*reinterpret_cast<void**>(pointer) = slab->freeSlots;
+		slab->freeSlots = pointer;
+		m_usedBlocks--;
+
+		if (slab->used-- == BlocksPerSlab)
+		{
+			unlink(m_full, slab);
+			link(m_partial, slab);
+		}
+
+		if (!slab->used)
+		{
+			unlink(m_partial, slab);
+
+			if (m_emptySlab)
+			{
+				m_parent.deallocate(slab);
+				m_slabCount--;
+			}
+			else
+			{
+				m_emptySlab = slab;
+			}
+		}
+	}
+
+	template <typename... Args>
+	T* create(Args&&... args)
+	{
+		T* result = allocate();
+
+		if (result)
+		{
+			::new(result) T(std::forward<Args>(args)...);
+		}
+
+		return result;
+	}
+
+	void destroy(T* pointer)
+	{
+		if (pointer)
+		{
+			pointer->~T();
+			deallocate(pointer);
+		}
+	}
+
+	size_type getSlabCount() const { return m_slabCount; }
+	size_type getUsedBlocks() const { return m_usedBlocks; }
+
+private:
+	MemoryAllocator& m_parent;
+	// Slabs with both used and free slots; allocation always serves the head.
+	pool_slab* m_partial;
+	pool_slab* m_emptySlab;
+	pool_slab* m_full;
+	size_type m_slabCount;
+	size_type m_usedBlocks;
+
+	static size_type slabAlignment()
+	{
+		size_type alignment = ALIGNMENT;
+
+		while (alignment < SLAB_SIZE)
+		{
+			alignment <<= 1;
+		}
+
+		return alignment;
+	}
+
+	static pool_slab* slabOf(void* pointer)
+	{
+		return reinterpret_cast<pool_slab*>(reinterpret_cast<size_type>(pointer) & ~(slabAlignment() - 1));
+	}
+
+	pool_slab* takeSlab()
+	{
+		pool_slab* slab = m_emptySlab;
+
+		if (slab)
+		{
+			m_emptySlab = nullptr;
+		}
+		else
+		{
+			slab = static_cast<pool_slab*>(m_parent.allocateAligned(SLAB_SIZE, slabAlignment()));
+
+			if (!slab)
+			{
+				return nullptr;
+			}
+
+			slab->freeSlots = nullptr;
+			slab->used = 0;
+			slab->carved = 0;
+			m_slabCount++;
+		}
+
+		link(m_partial, slab);
+		return slab;
+	}
+
+	static void link(pool_slab*& list, pool_slab* slab)
+	{
+		slab->previous = nullptr;
+		slab->next = list;
+
+		if (list)
+		{
+			list->previous = slab;
+		}
+
+		list = slab;
+	}
+
+	static void unlink(pool_slab*& list, pool_slab* slab)
+	{
+		if (slab->previous)
+		{
+			slab->previous->next = slab->next;
+		}
+		else
+		{
+			list = slab->next;
+		}
+
+		if (slab->next)
+		{
+			slab->next->previous = slab->previous;
+		}
+	}
+
+	void releaseList(pool_slab* list)
+	{
+		while (list)
+		{
+			pool_slab* next = list->next;
+			m_parent.deallocate(list);
+			list = next;
+		}
+	}
+};
+
+template <typename T, size_type BlocksPerSlab>
+const size_type PoolAllocator<T, BlocksPerSlab>::SLOT_ALIGNMENT;
+template <typename T, size_type BlocksPerSlab>
+const size_type PoolAllocator<T, BlocksPerSlab>::SLOT_SIZE;
+template <typename T, size_type BlocksPerSlab>
+const size_type PoolAllocator<T, BlocksPerSlab>::SLOTS_OFFSET;
+template <typename T, size_type BlocksPerSlab>
+const size_type PoolAllocator<T, BlocksPerSlab>::SLAB_SIZE;
@@ -0,0 +1,140 @@
+#include "SmallBlocks.h"
+#include "BitOps.h"
+#include "PageSource.h"
+#include <atomic>
+#include <mutex>
+
+// A run's bitmap is a single 256-bit word, and on the churn benchmark the vector scan
+// lost to checking the first word directly, so it has to be asked for.
+#if !defined(MEMORY_ALLOCATOR_AVX2_SCAN)
+#define MEMORY_ALLOCATOR_AVX2_SCAN 0
+#endif
+
+#if MEMORY_ALLOCATOR_AVX2_SCAN && defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+static_assert(SMALL_RUN_SIZE / ALIGNMENT <= SMALL_BITMAP_WORDS * 64, "a run holds more slots than its bitmap");
+
+// Address space only; pages are committed one run at a time.
+const size_type SMALL_REGION_SIZE = sizeof(void*) == 8 ? size_type(1) << 30 : size_type(64) << 20;
+
+static std::mutex s_regionLock;
+// Published once under the lock; pointers into the range can only come from after that.
+static std::atomic<size_type> s_regionBegin(0);
+static char* s_regionTop = nullptr;
+static char* s_regionEnd = nullptr;
+static bool s_regionFailed = false;
+static small_run* s_freeRuns = nullptr;
+
+bool isSmallBlock(const void* pointer)
+{
+	size_type begin = s_regionBegin.load(std::memory_order_relaxed);
+
+	return begin && reinterpret_cast<size_type>(pointer) - begin < SMALL_REGION_SIZE;
+}
+
+small_run* acquireRun(size_type slotSize, int arena)
+{
+	small_run* run;
+
+	{
+		std::lock_guard<std::mutex> guard(s_regionLock);
+
+		if (s_freeRuns)
+		{
+			run = s_freeRuns;
+			s_freeRuns = run->next;
+		}
+		else
+		{
+			if (!s_regionTop && !s_regionFailed)
+			{
+				s_regionTop = static_cast<char*>(reservePages(SMALL_REGION_SIZE));
+				s_regionFailed = !s_regionTop;
+
+				if (s_regionTop)
+				{
+					s_regionEnd = s_regionTop + SMALL_REGION_SIZE;
+					s_regionBegin.store(reinterpret_cast<size_type>(s_regionTop), std::memory_order_release);
+				}
+			}
+
+			if (!s_regionTop || s_regionTop == s_regionEnd)
+			{
+				return nullptr;
+			}
+
+			run = reinterpret_cast<small_run*>(s_regionTop);
+			s_regionTop += SMALL_RUN_SIZE;
+			recommitPages(run, SMALL_RUN_SIZE);
+		}
+	}
+
+	size_type slotCount = (SMALL_RUN_SIZE - slotsOffset()) / slotSize;
+
+	for (int i = 0; i < SMALL_BITMAP_WORDS; i++)
+	{
+		size_type first = i * 64;
+
+		if (slotCount >= first + 64)
+		{
+			run->freeSlots[i] = ~std::uint64_t(0);
+		}
+		else if (slotCount > first)
+		{
+			run->freeSlots[i] = (std::uint64_t(1) << (slotCount - first)) - 1;
+		}
+		else
+		{
+			run->freeSlots[i] = 0;
+		}
+	}
+
+	run->previous = nullptr;
+	run->next = nullptr;
+	run->slotSize = static_cast<std::uint32_t>(slotSize);
+	run->slotReciprocal = static_cast<std::uint32_t>(((std::uint64_t(1) << 32) + slotSize - 1) / slotSize);
+	run->slotCount = static_cast<std::uint32_t>(slotCount);
+	run->used = 0;
+	run->arena = arena;
+
+	return run;
+}
+
+void releaseRun(small_run* run)
+{
+	std::lock_guard<std::mutex> guard(s_regionLock);
+
+	run->next = s_freeRuns;
+	s_freeRuns = run;
+}
+
+int findFreeSlot(const small_run* run)
+{
+#if MEMORY_ALLOCATOR_AVX2_SCAN && defined(__AVX2__)
+	__m256i words = _mm256_load_si256(reinterpret_cast<const __m256i*>(run->freeSlots));
+
+	if (_mm256_testz_si256(words, words))
+	{
+		return -1;
+	}
+
+	// One sign bit per 64-bit lane that still has a free slot.
+	__m256i emptyWords = _mm256_cmpeq_epi64(words, _mm256_setzero_si256());
+	int occupiedLanes = ~_mm256_movemask_pd(_mm256_castsi256_pd(emptyWords)) & 15;
+	int word = findLowestBit(static_cast<std::uint64_t>(occupiedLanes));
+
+	return word * 64 + findLowestBit(run->freeSlots[word]);
+#else
+	for (int i = 0; i < SMALL_BITMAP_WORDS; i++)
+	{
+		if (run->freeSlots[i])
+		{
+			return i * 64 + findLowestBit(run->freeSlots[i]);
+		}
+	}
+
+	return -1;
+#endif
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "MemoryAllocator.h"
+
+// Small-block runs are cut from one address range reserved for the whole process,
+// so telling a slot from a tagged block is a range check.
+
+bool isSmallBlock(const void*);
+
+inline small_run* runOf(const void* pointer)
+{
+	return reinterpret_cast<small_run*>(reinterpret_cast<size_type>(pointer) & ~(SMALL_RUN_SIZE - 1));
+}
+
+inline size_type slotsOffset()
+{
+	return (sizeof(small_run) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+// Takes a committed run off the shared range with every slot free, or returns
+// nullptr once the range is used up. Both calls lock the range.
+small_run* acquireRun(size_type slotSize, int arena);
+void releaseRun(small_run*);
+
+// Index of the lowest free slot, or -1 when the run is full. Scans word by word, or
+// tests the whole 256-bit bitmap at once on AVX2 builds with MEMORY_ALLOCATOR_AVX2_SCAN.
+int findFreeSlot(const small_run*);
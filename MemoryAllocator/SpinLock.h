@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <thread>
+
+// Test-and-test-and-set lock for short critical sections such as one arena call.
+// Meets the Lockable requirements, so it works with std::lock_guard.
+class SpinLock
+{
+public:
+
+	SpinLock() : m_locked(false) {}
+	SpinLock(const SpinLock&) = delete;
+	SpinLock& operator=(const SpinLock&) = delete;
+
+	void lock()
+	{
+		int spins = 0;
+
+		while (!try_lock())
+		{
+			// Waiting on a plain load keeps the line shared until the owner lets go.
+			while (m_locked.load(std::memory_order_relaxed))
+			{
+				if (++spins == 64)
+				{
+					spins = 0;
+					std::this_thread::yield();
+				}
+			}
+		}
+	}
+
+	bool try_lock()
+	{
+		return !m_locked.load(std::memory_order_relaxed) && !m_locked.exchange(true, std::memory_order_acquire);
+	}
+
+	void unlock()
+	{
+		m_locked.store(false, std::memory_order_release);
+	}
+
+private:
+	std::atomic<bool> m_locked;
+};
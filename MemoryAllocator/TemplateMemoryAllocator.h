@@ -1,5 +1,6 @@
 #pragma once
 #include "MemoryAllocator.h"
+#include <new>
 
 
 template <typename T>
@@ -18,9 +19,22 @@ struct MallocAllocator {
 
 	pointer allocate(size_type n, const void* = 0)
 	{
+		// Over-aligned types need more than the block payload alignment.
+		if (alignof(T) > ALIGNMENT)
+		{
+			return static_cast<T*>(m_allocator.allocateAligned(n * sizeof(T), alignof(T)));
+		}
+
 		return static_cast<T*>(m_allocator.allocate(n * sizeof(T)));
 	}
 
+#if defined(__cpp_aligned_new)
+	pointer allocate(size_type n, std::align_val_t alignment)
+	{
+		return static_cast<T*>(m_allocator.allocateAligned(n * sizeof(T), static_cast<size_type>(alignment)));
+	}
+#endif
+
 	void deallocate(pointer ptr, size_type) { 
 		m_allocator.deallocate(ptr);
 	}
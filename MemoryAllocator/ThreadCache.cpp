@@ -0,0 +1,223 @@
+#include "ThreadCache.h"
+#include <mutex>
+
+struct central_heap
+{
+	explicit central_heap(const MemoryAllocatorOptions& options) : arena(options) {}
+
+	std::mutex lock;
+	MemoryAllocator arena;
+};
+
+struct magazine
+{
+	void* blocks[MAGAZINE_SIZE];
+	int count;
+};
+
+struct thread_cache
+{
+	std::shared_ptr<central_heap> central;
+	magazine magazines[CACHE_CLASS_COUNT];
+	thread_cache* next;
+};
+
+// All caches of one thread, one per allocator it has used. Destroying the list at
+// thread exit drains every cache back to its central arena.
+struct thread_cache_list
+{
+	thread_cache* head;
+
+	~thread_cache_list();
+};
+
+static thread_local thread_cache_list t_caches = { nullptr };
+// Most threads use one allocator, so the last hit is checked before the list.
+static thread_local thread_cache* t_lastCache = nullptr;
+
+static void drain(thread_cache* cache, magazine& drained, int keep)
+{
+	std::lock_guard<std::mutex> guard(cache->central->lock);
+	cache->central->arena.deallocateBatch(drained.blocks + keep, drained.count - keep);
+	drained.count = keep;
+}
+
+static void drainAll(thread_cache* cache)
+{
+	std::lock_guard<std::mutex> guard(cache->central->lock);
+
+	for (int i = 0; i < CACHE_CLASS_COUNT; i++)
+	{
+		cache->central->arena.deallocateBatch(cache->magazines[i].blocks, cache->magazines[i].count);
+		cache->magazines[i].count = 0;
+	}
+}
+
+thread_cache_list::~thread_cache_list()
+{
+	while (head)
+	{
+		thread_cache* next = head->next;
+		drainAll(head);
+		delete head;
+		head = next;
+	}
+
+	t_lastCache = nullptr;
+}
+
+ThreadCachingAllocator::ThreadCachingAllocator() : ThreadCachingAllocator(MemoryAllocatorOptions())
+{}
+
+ThreadCachingAllocator::ThreadCachingAllocator(const MemoryAllocatorOptions& options)
+	: m_central(std::make_shared<central_heap>(MemoryAllocatorOptions::tagged(options)))
+{}
+
+ThreadCachingAllocator::~ThreadCachingAllocator()
+{
+	// Other threads' caches keep the central arena alive until they exit.
+	thread_cache** link = &t_caches.head;
+
+	while (*link && (*link)->central != m_central)
+	{
+		link = &(*link)->next;
+	}
+
+	if (*link)
+	{
+		thread_cache* cache = *link;
+		*link = cache->next;
+
+		if (t_lastCache == cache)
+		{
+			t_lastCache = nullptr;
+		}
+
+		drainAll(cache);
+		delete cache;
+	}
+}
+
+void* ThreadCachingAllocator::allocate(size_type n)
+{
+	size_type size = MemoryAllocator::blockSize(n);
+
+	if (size > MAX_CACHED_SIZE)
+	{
+		std::lock_guard<std::mutex> guard(m_central->lock);
+		return m_central->arena.allocate(n);
+	}
+
+	magazine& current = localCache()->magazines[size / ALIGNMENT];
+
+	if (!current.count)
+	{
+		std::lock_guard<std::mutex> guard(m_central->lock);
+		current.count = static_cast<int>(m_central->arena.allocateBatch(size - sizeof(info_header), MAGAZINE_SIZE / 2, current.blocks));
+
+		if (!current.count)
+		{
+			return nullptr;
+		}
+	}
+
+	return current.blocks[--current.count];
+}
+
+void ThreadCachingAllocator::deallocate(void* pointer)
+{
+	if (!pointer)
+	{
+		return;
+	}
+
+	size_type size = MemoryAllocator::usableSize(pointer) + sizeof(info_header);
+
+	if (size > MAX_CACHED_SIZE)
+	{
+		std::lock_guard<std::mutex> guard(m_central->lock);
+		m_central->arena.deallocate(pointer);
+		return;
+	}
+
+	thread_cache* cache = localCache();
+	magazine& current = cache->magazines[size / ALIGNMENT];
+
+	if (current.count == MAGAZINE_SIZE)
+	{
+		drain(cache, current, MAGAZINE_SIZE / 2);
+	}
+
+	current.blocks[current.count++] = pointer;
+}
+
+void ThreadCachingAllocator::flushThreadCache()
+{
+	thread_cache* cache = findCache();
+
+	if (cache)
+	{
+		drainAll(cache);
+	}
+}
+
+std::uint64_t ThreadCachingAllocator::getUsedCells() const
+{
+	std::lock_guard<std::mutex> guard(m_central->lock);
+	return m_central->arena.getUsedCells();
+}
+
+std::uint64_t ThreadCachingAllocator::getFreeCells() const
+{
+	std::lock_guard<std::mutex> guard(m_central->lock);
+	return m_central->arena.getFreeCells();
+}
+
+size_type ThreadCachingAllocator::getCachedBlocks() const
+{
+	thread_cache* cache = findCache();
+	size_type result = 0;
+
+	if (cache)
+	{
+		for (int i = 0; i < CACHE_CLASS_COUNT; i++)
+		{
+			result += cache->magazines[i].count;
+		}
+	}
+
+	return result;
+}
+
+thread_cache* ThreadCachingAllocator::localCache() const
+{
+	if (t_lastCache && t_lastCache->central == m_central)
+	{
+		return t_lastCache;
+	}
+
+	thread_cache* cache = findCache();
+
+	if (!cache)
+	{
+		cache = new thread_cache();
+		cache->central = m_central;
+		cache->next = t_caches.head;
+		t_caches.head = cache;
+	}
+
+	t_lastCache = cache;
+	return cache;
+}
+
+thread_cache* ThreadCachingAllocator::findCache() const
+{
+	thread_cache* cache = t_caches.head;
+
+	while (cache && cache->central != m_central)
+	{
+		cache = cache->next;
+	}
+
+	return cache;
+}
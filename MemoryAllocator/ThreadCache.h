@@ -0,0 +1,46 @@
+#pragma once
+#include "MemoryAllocator.h"
+#include <memory>
+
+// Blocks up to MAX_CACHED_SIZE bytes (tag included) are served from per-thread
+// magazines, one per ALIGNMENT-sized class.
+const size_type MAX_CACHED_SIZE = 1024;
+const int CACHE_CLASS_COUNT = MAX_CACHED_SIZE / ALIGNMENT + 1;
+const int MAGAZINE_SIZE = 32;
+
+struct central_heap;
+struct thread_cache;
+
+// Thread-safe front end over one central MemoryAllocator. Small allocations and
+// frees stay in the calling thread's cache and take no lock; the central arena is
+// locked only to refill or drain half a magazine at a time, and for big blocks.
+// A thread's cache goes back to the central arena when the thread exits.
+class ThreadCachingAllocator
+{
+public:
+
+	ThreadCachingAllocator();
+	// Magazines are picked by the block tag, so the Buddy engine is replaced by SegregatedFit.
+	explicit ThreadCachingAllocator(const MemoryAllocatorOptions&);
+	ThreadCachingAllocator(const ThreadCachingAllocator&) = delete;
+	ThreadCachingAllocator& operator=(const ThreadCachingAllocator&) = delete;
+	~ThreadCachingAllocator();
+
+	void* allocate(size_type);
+	void deallocate(void*);
+
+	// Hands the calling thread's cached blocks back to the central arena.
+	void flushThreadCache();
+
+	// Central arena view: blocks sitting in thread caches count as used.
+	std::uint64_t getUsedCells() const;
+	std::uint64_t getFreeCells() const;
+	// Blocks cached by the calling thread for this allocator.
+	size_type getCachedBlocks() const;
+
+private:
+	std::shared_ptr<central_heap> m_central;
+
+	thread_cache* localCache() const;
+	thread_cache* findCache() const;
+};
@@ -1,5 +1,12 @@
 #include <iostream>
 #include "TemplateMemoryAllocator.h"
+#include "CpuShards.h"
+#include "MemoryAllocatorImpl.h"
+#include "MultiArena.h"
+#include "PoolAllocator.h"
+#include "ThreadCache.h"
+#include <cstring>
+#include <thread>
 #include <vector>
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
@@ -67,4 +74,1568 @@ TEST_CASE("Testing memory allocator") {
 	//dude.push_back(200);
 	//dude.push_back(210);
 
-}
\ No newline at end of file
+}
+
+TEST_CASE("Testing size class free lists") {
+
+	MemoryAllocator mAloc;
+	void* blocks[200];
+
+	for (int i = 0; i < 200; i++)
+	{
+		blocks[i] = mAloc.allocate(16 + (i % 10) * 24);
+		CHECK(blocks[i]);
+	}
+
+	// Free every other block so the lists hold many non-adjacent blocks of mixed sizes.
+	for (int i = 0; i < 200; i += 2)
+	{
+		mAloc.deallocate(blocks[i]);
+	}
+
+	CHECK(mAloc.getUsedCells() == 100);
+	CHECK(mAloc.getFreeCells() == 101);
+
+	// The largest freed size is served from one of the holes instead of the untouched tail.
+	void* reused = mAloc.allocate(16 + 8 * 24);
+	CHECK(reused < blocks[199]);
+	CHECK(mAloc.getFreeCells() == 100);
+
+	mAloc.deallocate(reused);
+
+	for (int i = 1; i < 200; i += 2)
+	{
+		mAloc.deallocate(blocks[i]);
+	}
+
+	CHECK(mAloc.getUsedCells() == 0);
+	CHECK(mAloc.getFreeCells() == 1);
+}
+
+TEST_CASE("Testing TLSF engine") {
+
+	MemoryAllocator mAloc(AllocationEngine::Tlsf);
+	void* blocks[64];
+
+	for (int i = 0; i < 64; i++)
+	{
+		blocks[i] = mAloc.allocate(24 + i * 40);
+		CHECK(blocks[i]);
+	}
+
+	for (int i = 0; i < 64; i += 2)
+	{
+		mAloc.deallocate(blocks[i]);
+	}
+
+	CHECK(mAloc.getUsedCells() == 32);
+	CHECK(mAloc.getFreeCells() == 33);
+
+	// A request well inside a freed hole's list is served from the hole.
+	void* reused = mAloc.allocate(1000);
+	CHECK(reused < blocks[63]);
+
+	mAloc.deallocate(reused);
+
+	for (int i = 1; i < 64; i += 2)
+	{
+		mAloc.deallocate(blocks[i]);
+	}
+
+	CHECK(mAloc.getUsedCells() == 0);
+	CHECK(mAloc.getFreeCells() == 1);
+}
+
+TEST_CASE("Testing growable chunks") {
+
+	MemoryAllocatorOptions options;
+	options.chunkSize = 4096;
+	options.retainedFreeChunks = 1;
+	MemoryAllocator mAloc(options);
+
+	void* blocks[40];
+
+	for (int i = 0; i < 40; i++)
+	{
+		blocks[i] = mAloc.allocate(400);
+		CHECK(blocks[i]);
+	}
+
+	CHECK(mAloc.getChunkCount() > 1);
+	CHECK(mAloc.getUsedCells() == 40);
+
+	// Requests bigger than a chunk get a chunk of their own.
+	void* big = mAloc.allocate(100000);
+	CHECK(big);
+
+	mAloc.deallocate(big);
+
+	for (int i = 0; i < 40; i++)
+	{
+		mAloc.deallocate(blocks[i]);
+	}
+
+	// Only the retained chunk survives, and nothing coalesced across chunk boundaries.
+	CHECK(mAloc.getUsedCells() == 0);
+	CHECK(mAloc.getChunkCount() == 1);
+	CHECK(mAloc.getFreeCells() == 1);
+
+	MemoryAllocatorOptions limited;
+	limited.chunkSize = 4096;
+	limited.maxArenaSize = 4096;
+	MemoryAllocator bounded(limited);
+
+	CHECK(bounded.allocate(1000));
+	CHECK_FALSE(bounded.allocate(5000));
+}
+
+TEST_CASE("Testing mapped arena page purging") {
+
+	MemoryAllocatorOptions options;
+	options.backing = ArenaBacking::Mapped;
+	options.purgeFreePages = true;
+	options.chunkSize = 4 * 1024 * 1024;
+	MemoryAllocator mAloc(options);
+
+	CHECK(mAloc.getReservedBytes() == options.chunkSize);
+	CHECK(mAloc.getCommittedBytes() == mAloc.getReservedBytes());
+
+	void* first = mAloc.allocate(512 * 1024);
+	void* second = mAloc.allocate(512 * 1024);
+	void* third = mAloc.allocate(64);
+
+	// Freeing the first block purges it; the second merges with the tail and
+	// the combined block is purged again.
+	mAloc.deallocate(first);
+	CHECK(mAloc.getCommittedBytes() < mAloc.getReservedBytes());
+
+	mAloc.deallocate(second);
+	size_type committed = mAloc.getCommittedBytes();
+	CHECK(committed < mAloc.getReservedBytes() - 512 * 1024);
+
+	// Reusing the purged memory commits it again and it is writable.
+	char* reused = static_cast<char*>(mAloc.allocate(256 * 1024));
+	CHECK(mAloc.getCommittedBytes() > committed);
+	reused[0] = 1;
+	reused[256 * 1024 - 1] = 1;
+
+	mAloc.deallocate(reused);
+	mAloc.deallocate(third);
+
+	CHECK(mAloc.getUsedCells() == 0);
+	CHECK(mAloc.getFreeCells() == 1);
+}
+
+static void countReports(const char*, const void*, void* context)
+{
+	++*static_cast<int*>(context);
+}
+
+TEST_CASE("Testing heap verification") {
+
+	MemoryAllocator mAloc(AllocationEngine::Tlsf);
+	int reports = 0;
+	mAloc.setVerifyCallback(countReports, &reports);
+
+	void* blocks[100];
+
+	for (int i = 0; i < 100; i++)
+	{
+		blocks[i] = mAloc.allocate(8 + (i * 37) % 500);
+	}
+
+	for (int i = 0; i < 100; i += 3)
+	{
+		mAloc.deallocate(blocks[i]);
+	}
+
+	CHECK(mAloc.verifyHeap());
+	CHECK(reports == 0);
+
+	// Damage the footer of a free block; the verifier must notice.
+	info_header* header = static_cast<info_header*>(blocks[0]) - 1;
+	info_header* footer = reinterpret_cast<info_header*>(reinterpret_cast<char*>(header) + header->size()) - 1;
+	footer->m_tag += ALIGNMENT;
+
+	CHECK_FALSE(mAloc.verifyHeap());
+	CHECK(reports > 0);
+
+	footer->m_tag -= ALIGNMENT;
+	reports = 0;
+
+	for (int i = 0; i < 100; i++)
+	{
+		if (i % 3)
+		{
+			mAloc.deallocate(blocks[i]);
+		}
+	}
+
+	CHECK(mAloc.verifyHeap());
+	CHECK(reports == 0);
+}
+
+TEST_CASE("Testing occupancy counters") {
+
+	MemoryAllocatorOptions options;
+	options.chunkSize = 8192;
+	MemoryAllocator mAloc(options);
+
+	std::uint64_t total = mAloc.getFreeAmount();
+	CHECK(mAloc.getUsedAmount() == 0);
+
+	void* blocks[50];
+
+	for (int i = 0; i < 50; i++)
+	{
+		blocks[i] = mAloc.allocate(100 + i * 10);
+	}
+
+	// Growing the arena adds to the free amount; everything else is conserved.
+	CHECK(mAloc.getUsedCells() == 50);
+	CHECK(mAloc.getUsedAmount() + mAloc.getFreeAmount() > total);
+	CHECK(mAloc.verifyHeap());
+
+	for (int i = 0; i < 50; i += 2)
+	{
+		mAloc.deallocate(blocks[i]);
+	}
+
+	CHECK(mAloc.getUsedCells() == 25);
+	CHECK(mAloc.verifyHeap());
+
+	for (int i = 1; i < 50; i += 2)
+	{
+		mAloc.deallocate(blocks[i]);
+	}
+
+	CHECK(mAloc.getUsedCells() == 0);
+	CHECK(mAloc.getUsedAmount() == 0);
+	CHECK(mAloc.getFreeAmount() == total);
+}
+
+TEST_CASE("Testing compact block tags") {
+
+	MemoryAllocator mAloc;
+
+	// Small requests cost one 8-byte tag and are rounded to ALIGNMENT.
+	char* first = static_cast<char*>(mAloc.allocate(8));
+	char* second = static_cast<char*>(mAloc.allocate(24));
+	char* third = static_cast<char*>(mAloc.allocate(40));
+
+	CHECK(reinterpret_cast<size_type>(first) % ALIGNMENT == 0);
+	CHECK(reinterpret_cast<size_type>(second) % ALIGNMENT == 0);
+	CHECK(second - first == 32);
+	CHECK(third - second == 32);
+	CHECK(mAloc.getUsedAmount() == 32 + 32 + 48);
+
+	// A used block's last word belongs to the payload.
+	for (int i = 0; i < 24; i++)
+	{
+		second[i] = 'x';
+	}
+
+	mAloc.deallocate(first);
+	CHECK(mAloc.verifyHeap());
+	CHECK(second[23] == 'x');
+
+	mAloc.deallocate(third);
+	mAloc.deallocate(second);
+
+	CHECK(mAloc.getUsedCells() == 0);
+	CHECK(mAloc.getFreeCells() == 1);
+}
+
+struct alignas(64) CacheLine
+{
+	char bytes[64];
+};
+
+TEST_CASE("Testing aligned allocation") {
+
+	MemoryAllocator mAloc;
+
+	void* unaligned = mAloc.allocate(24);
+	CHECK(mAloc.getFreeCells() == 1);
+
+	for (size_type alignment = 32; alignment <= 4096; alignment *= 2)
+	{
+		void* aligned = mAloc.allocateAligned(100, alignment);
+		CHECK(reinterpret_cast<size_type>(aligned) % alignment == 0);
+
+		mAloc.deallocate(aligned);
+		CHECK(mAloc.verifyHeap());
+	}
+
+	CHECK_FALSE(mAloc.allocateAligned(100, 48));
+
+	// The padding in front of an aligned block is a free block, so it can be reused.
+	void* aligned = mAloc.allocateAligned(64, 4096);
+	CHECK(mAloc.getFreeCells() == 2);
+
+	void* filler = mAloc.allocate(64);
+	CHECK(filler < aligned);
+
+	mAloc.deallocate(filler);
+	mAloc.deallocate(aligned);
+	mAloc.deallocate(unaligned);
+
+	CHECK(mAloc.getUsedCells() == 0);
+	CHECK(mAloc.getFreeCells() == 1);
+
+	MallocAllocator<CacheLine> lines;
+	CacheLine* line = lines.allocate(3);
+	CHECK(reinterpret_cast<size_type>(line) % 64 == 0);
+	lines.deallocate(line, 3);
+}
+
+TEST_CASE("Testing in-place reallocation") {
+
+	MemoryAllocator mAloc;
+
+	char* buffer = static_cast<char*>(mAloc.allocate(100));
+	void* neighbour = mAloc.allocate(400);
+	void* fence = mAloc.allocate(16);
+
+	for (int i = 0; i < 100; i++)
+	{
+		buffer[i] = static_cast<char>(i);
+	}
+
+	// Blocked by a used neighbour.
+	CHECK_FALSE(mAloc.tryExpand(buffer, 300));
+
+	mAloc.deallocate(neighbour);
+
+	// The free neighbour is absorbed and the rest of it stays free.
+	CHECK(mAloc.tryExpand(buffer, 300));
+	CHECK(mAloc.getFreeCells() == 2);
+	CHECK(mAloc.reallocate(buffer, 500) == static_cast<void*>(buffer));
+	CHECK(buffer[99] == 99);
+
+	// Shrinking gives the tail back, merged with the free block after it.
+	std::uint64_t used = mAloc.getUsedAmount();
+	CHECK(mAloc.tryExpand(buffer, 50));
+	CHECK(mAloc.getUsedAmount() < used);
+	CHECK(mAloc.getFreeCells() == 2);
+
+	// Growing past the fence has to move.
+	char* moved = static_cast<char*>(mAloc.reallocate(buffer, 4000));
+	CHECK(static_cast<void*>(moved) != static_cast<void*>(buffer));
+	CHECK(moved[49] == 49);
+	CHECK(mAloc.verifyHeap());
+
+	mAloc.deallocate(moved);
+	mAloc.deallocate(fence);
+
+	CHECK(mAloc.getUsedCells() == 0);
+	CHECK(mAloc.getFreeCells() == 1);
+}
+
+TEST_CASE("Testing batch allocation") {
+
+	MemoryAllocator mAloc;
+	void* blocks[100];
+
+	CHECK(mAloc.allocateBatch(40, 100, blocks) == 100);
+	CHECK(mAloc.getUsedCells() == 100);
+	CHECK(mAloc.getFreeCells() == 1);
+
+	// One region, cut back to back.
+	for (int i = 1; i < 100; i++)
+	{
+		CHECK(static_cast<char*>(blocks[i]) - static_cast<char*>(blocks[i - 1]) == 48);
+	}
+
+	void* keep = blocks[50];
+	blocks[50] = nullptr;
+
+	// Free in scrambled order; the two runs around the kept block coalesce separately.
+	for (int i = 0; i < 100; i += 2)
+	{
+		std::swap(blocks[i], blocks[99 - i]);
+	}
+
+	mAloc.deallocateBatch(blocks, 100);
+
+	CHECK(mAloc.getUsedCells() == 1);
+	CHECK(mAloc.getFreeCells() == 2);
+	CHECK(mAloc.verifyHeap());
+
+	mAloc.deallocate(keep);
+
+	// A batch larger than a chunk spills into new chunks.
+	MemoryAllocatorOptions options;
+	options.chunkSize = 4096;
+	MemoryAllocator small(options);
+	void* many[300];
+
+	CHECK(small.allocateBatch(100, 300, many) == 300);
+	CHECK(small.getUsedCells() == 300);
+
+	small.deallocateBatch(many, 300);
+	CHECK(small.getUsedCells() == 0);
+	CHECK(small.verifyHeap());
+}
+
+TEST_CASE("Testing thread caches") {
+
+	ThreadCachingAllocator cached;
+
+	std::vector<std::thread> workers;
+
+	for (int t = 0; t < 8; t++)
+	{
+		workers.push_back(std::thread([&cached, t]()
+		{
+			std::vector<void*> live;
+
+			for (int round = 0; round < 2000; round++)
+			{
+				live.push_back(cached.allocate(16 + (round * 7 + t) % 200));
+
+				if (round % 3 == 2)
+				{
+					cached.deallocate(live[live.size() / 2]);
+					live.erase(live.begin() + live.size() / 2);
+				}
+			}
+
+			// Big blocks bypass the caches.
+			void* big = cached.allocate(5000);
+			cached.deallocate(big);
+
+			for (size_t i = 0; i < live.size(); i++)
+			{
+				cached.deallocate(live[i]);
+			}
+		}));
+	}
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+
+	// Every worker's cache went back to the central arena when it exited.
+	CHECK(cached.getUsedCells() == 0);
+
+	void* local = cached.allocate(40);
+	cached.deallocate(local);
+	CHECK(cached.getCachedBlocks() == MAGAZINE_SIZE / 2);
+	CHECK(cached.getUsedCells() == MAGAZINE_SIZE / 2);
+
+	cached.flushThreadCache();
+	CHECK(cached.getCachedBlocks() == 0);
+	CHECK(cached.getUsedCells() == 0);
+}
+
+TEST_CASE("Testing remote frees") {
+
+	MemoryAllocator owner;
+	std::vector<void*> blocks;
+
+	for (int i = 0; i < 400; i++)
+	{
+		blocks.push_back(owner.allocate(24 + i % 100));
+	}
+
+	CHECK(MemoryAllocator::ownerOf(blocks[0]) == &owner);
+
+	// Half of the blocks are freed through another arena, half without one.
+	std::thread first([&blocks]()
+	{
+		MemoryAllocator local;
+
+		for (size_t i = 0; i < 200; i++)
+		{
+			local.deallocate(blocks[i]);
+		}
+
+		CHECK(local.getUsedCells() == 0);
+	});
+
+	std::thread second([&blocks]()
+	{
+		for (size_t i = 200; i < 399; i++)
+		{
+			MemoryAllocator::deallocateRemote(blocks[i]);
+		}
+	});
+
+	first.join();
+	second.join();
+
+	// Nothing is reclaimed until the owner runs again.
+	CHECK(owner.getUsedCells() == 400);
+
+	void* next = owner.allocate(24);
+	CHECK(owner.getUsedCells() == 2);
+
+	owner.deallocate(next);
+	owner.deallocate(blocks[399]);
+	CHECK(owner.getUsedCells() == 0);
+	CHECK(owner.getFreeCells() == 1);
+
+	MemoryAllocator other;
+	void* foreign = other.allocate(100);
+	owner.deallocate(foreign);
+	CHECK(other.getUsedCells() == 1);
+
+	other.drainRemoteFrees();
+	CHECK(other.getUsedCells() == 0);
+
+	// Resizing a foreign block never touches the owner's heap; moves send the old
+	// block home.
+	char* grown = static_cast<char*>(other.allocate(100));
+	other.deallocate(other.allocate(400));
+	std::memset(grown, 0x5a, 100);
+
+	CHECK_FALSE(owner.tryExpand(grown, 300));
+	CHECK_FALSE(owner.tryExpand(grown, 40));
+
+	char* moved = static_cast<char*>(owner.reallocate(grown, 300));
+	CHECK(moved != grown);
+	CHECK(MemoryAllocator::ownerOf(moved) == &owner);
+	CHECK(moved[99] == 0x5a);
+
+	other.drainRemoteFrees();
+	CHECK(other.getUsedCells() == 0);
+	CHECK(other.verifyHeap());
+
+	owner.deallocate(moved);
+	CHECK(owner.verifyHeap());
+}
+
+TEST_CASE("Testing CPU sharded arenas") {
+
+	CHECK(currentCpu() >= 0);
+
+	MemoryAllocatorOptions options;
+	options.chunkSize = 64 * 1024;
+
+	CpuShardedAllocator sharded(4, options);
+	CHECK(sharded.getShardCount() == 4);
+	CHECK(sharded.getFreeCells() == 4);
+
+	std::vector<void*> handedOver(4000);
+	std::vector<std::thread> workers;
+
+	for (int t = 0; t < 4; t++)
+	{
+		workers.push_back(std::thread([&sharded, &handedOver, t]()
+		{
+			std::vector<void*> live;
+
+			for (int round = 0; round < 1000; round++)
+			{
+				live.push_back(sharded.allocate(16 + (round * 13 + t) % 300));
+				handedOver[t * 1000 + round] = sharded.allocate(32);
+
+				if (round % 2)
+				{
+					sharded.deallocate(live.back());
+					live.pop_back();
+				}
+			}
+
+			for (size_t i = 0; i < live.size(); i++)
+			{
+				sharded.deallocate(live[i]);
+			}
+		}));
+	}
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+
+	CHECK(sharded.getUsedCells() == 4000);
+
+	// Freed by a thread that may run on any CPU.
+	std::thread consumer([&sharded, &handedOver]()
+	{
+		for (size_t i = 0; i < handedOver.size(); i++)
+		{
+			sharded.deallocate(handedOver[i]);
+		}
+	});
+
+	consumer.join();
+
+	CHECK(sharded.getUsedCells() == 0);
+	CHECK(sharded.getUsedAmount() == 0);
+	CHECK(sharded.getReservedBytes() >= 4 * options.chunkSize);
+}
+
+TEST_CASE("Testing locked arenas") {
+
+	MemoryAllocator unlocked;
+	void* single = nullptr;
+	CHECK(unlocked.tryAllocate(100, single));
+	CHECK(single);
+	unlocked.deallocate(single);
+	CHECK(unlocked.getLockAcquires() == 0);
+
+	LockingPolicy policies[] = { LockingPolicy::Spin, LockingPolicy::Mutex };
+
+	for (int p = 0; p < 2; p++)
+	{
+		MemoryAllocatorOptions options;
+		options.locking = policies[p];
+		MemoryAllocator shared(options);
+
+		std::vector<std::thread> workers;
+
+		for (int t = 0; t < 4; t++)
+		{
+			workers.push_back(std::thread([&shared, t]()
+			{
+				std::vector<void*> live;
+
+				for (int round = 0; round < 500; round++)
+				{
+					live.push_back(shared.allocate(16 + (round * 5 + t) % 120));
+				}
+
+				for (size_t i = 0; i < live.size(); i++)
+				{
+					shared.deallocate(live[i]);
+				}
+			}));
+		}
+
+		for (size_t i = 0; i < workers.size(); i++)
+		{
+			workers[i].join();
+		}
+
+		CHECK(shared.getUsedCells() == 0);
+		CHECK(shared.getLockAcquires() >= 4000);
+		CHECK(shared.verifyHeap());
+	}
+
+	MultiArenaAllocator arenas(3);
+	CHECK(arenas.getArenaCount() == 3);
+
+	std::vector<void*> handedOver(4 * 300);
+	std::vector<std::thread> workers;
+
+	for (int t = 0; t < 4; t++)
+	{
+		workers.push_back(std::thread([&arenas, &handedOver, t]()
+		{
+			for (int round = 0; round < 300; round++)
+			{
+				void* scratch = arenas.allocate(48);
+				handedOver[t * 300 + round] = arenas.allocate(16 + round % 90);
+				arenas.deallocate(scratch);
+			}
+		}));
+	}
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+
+	CHECK(arenas.getUsedCells() == handedOver.size());
+
+	for (size_t i = 0; i < handedOver.size(); i++)
+	{
+		arenas.deallocate(handedOver[i]);
+	}
+
+	std::uint64_t acquires = 0;
+
+	for (int i = 0; i < arenas.getArenaCount(); i++)
+	{
+		acquires += arenas.getArena(i).getLockAcquires();
+		CHECK(arenas.getArena(i).getUsedCells() == 0);
+	}
+
+	CHECK(acquires >= 3 * handedOver.size());
+
+	// A capped arena that misses passes the request on to the others.
+	MemoryAllocatorOptions capped;
+	capped.chunkSize = 4096;
+	capped.maxArenaSize = 4096;
+
+	MultiArenaAllocator bounded(2, capped);
+	std::vector<void*> filled;
+	void* block;
+
+	while ((block = bounded.allocate(100)) != nullptr)
+	{
+		filled.push_back(block);
+	}
+
+	CHECK(bounded.getArena(0).getUsedCells() > 0);
+	CHECK(bounded.getArena(1).getUsedCells() > 0);
+
+	for (size_t i = 0; i < filled.size(); i++)
+	{
+		bounded.deallocate(filled[i]);
+	}
+
+	CHECK(bounded.getUsedCells() == 0);
+}
+
+struct OrderNode
+{
+	OrderNode(std::int64_t price, int quantity) : price(price), quantity(quantity) {}
+
+	std::int64_t price;
+	int quantity;
+};
+
+TEST_CASE("Testing slab pools") {
+
+	MemoryAllocator parent;
+	std::vector<OrderNode*> orders;
+
+	{
+		PoolAllocator<OrderNode, 64> pool(parent);
+		CHECK(pool.SLOT_SIZE == sizeof(OrderNode));
+
+		for (int i = 0; i < 1000; i++)
+		{
+			orders.push_back(pool.create(i * 100, i));
+		}
+
+		CHECK(pool.getUsedBlocks() == 1000);
+		CHECK(pool.getSlabCount() == 16);
+		CHECK(parent.getUsedCells() == 16);
+		// Little more than one bare slot per order, where a tagged block costs twice that.
+		CHECK(parent.getUsedAmount() < 1000 * (pool.SLOT_SIZE + 2));
+		CHECK(MemoryAllocator::blockSize(sizeof(OrderNode)) == 2 * pool.SLOT_SIZE);
+
+		for (int i = 0; i < 1000; i++)
+		{
+			CHECK(orders[i]->price == i * 100);
+		}
+
+		// Slots are reused before new slabs are taken.
+		OrderNode* freed = orders[500];
+		pool.destroy(freed);
+		CHECK(pool.create(1, 1) == freed);
+
+		for (int i = 0; i < 1000; i++)
+		{
+			pool.destroy(orders[i]);
+		}
+
+		CHECK(pool.getUsedBlocks() == 0);
+		CHECK(pool.getSlabCount() == 1);
+		CHECK(parent.getUsedCells() == 1);
+
+		pool.destroy(pool.create(7, 7));
+		CHECK(pool.getSlabCount() == 1);
+	}
+
+	CHECK(parent.getUsedCells() == 0);
+}
+
+TEST_CASE("Testing small block runs") {
+
+	MemoryAllocatorOptions options;
+	options.smallBlocks = true;
+	MemoryAllocator small(options);
+
+	std::vector<void*> blocks;
+
+	for (int i = 0; i < 3000; i++)
+	{
+		size_type size = 1 + (i * 37) % MAX_SMALL_SIZE;
+		char* block = static_cast<char*>(small.allocate(size));
+
+		CHECK(reinterpret_cast<size_type>(block) % ALIGNMENT == 0);
+		CHECK(MemoryAllocator::usableSize(block) >= size);
+		CHECK(MemoryAllocator::usableSize(block) < size + ALIGNMENT);
+		CHECK(MemoryAllocator::ownerOf(block) == &small);
+
+		std::memset(block, i, size);
+		blocks.push_back(block);
+	}
+
+	// Slots take no tagged blocks at all.
+	CHECK(small.getSmallBlockCount() == 3000);
+	CHECK(small.getUsedCells() == 0);
+
+	// Bursts of frees and refills reuse the lowest free slots.
+	for (int burst = 0; burst < 10; burst++)
+	{
+		for (size_t i = burst; i < blocks.size(); i += 3)
+		{
+			small.deallocate(blocks[i]);
+		}
+
+		for (size_t i = burst; i < blocks.size(); i += 3)
+		{
+			blocks[i] = small.allocate(1 + (i * 37) % MAX_SMALL_SIZE);
+		}
+	}
+
+	CHECK(small.getSmallBlockCount() == 3000);
+
+	// Bigger requests, and slots that outgrow their class, use tagged blocks.
+	void* big = small.allocate(MAX_SMALL_SIZE + 1);
+	CHECK(small.getUsedCells() == 1);
+	CHECK(small.tryExpand(blocks[0], 16));
+	CHECK_FALSE(small.tryExpand(blocks[0], 1000));
+
+	std::memset(blocks[1], 0x5a, 1 + 37);
+	void* moved = small.reallocate(blocks[1], 1000);
+	CHECK(static_cast<unsigned char*>(moved)[37] == 0x5a);
+	blocks[1] = moved;
+	CHECK(small.getUsedCells() == 2);
+	CHECK(small.getSmallBlockCount() == 2999);
+
+	// A slot freed through another arena waits on its owner's remote stack.
+	MemoryAllocator other(options);
+	other.deallocate(blocks[2]);
+	CHECK(small.getSmallBlockCount() == 2999);
+	small.deallocate(big);
+	CHECK(small.getSmallBlockCount() == 2998);
+
+	for (size_t i = 3; i < blocks.size(); i++)
+	{
+		small.deallocate(blocks[i]);
+	}
+
+	small.deallocate(blocks[0]);
+	small.deallocate(blocks[1]);
+
+	CHECK(small.getSmallBlockCount() == 0);
+	CHECK(small.getUsedCells() == 0);
+	// One empty run stays per class.
+	CHECK(small.getSmallRunCount() == size_type(SMALL_CLASS_COUNT));
+	CHECK(small.verifyHeap());
+}
+
+TEST_CASE("Testing buddy engine") {
+
+	MemoryAllocator buddy(AllocationEngine::Buddy);
+
+	CHECK(buddy.getChunkCount() == 1);
+	CHECK(buddy.getFreeCells() == 1);
+	CHECK(buddy.getFreeAmount() == 1024 * 1024);
+
+	// A 4000 byte buffer takes a 4 KiB block, split off a 1 MiB region.
+	char* first = static_cast<char*>(buddy.allocate(4000));
+	CHECK(buddy.getUsedAmount() == 4096);
+	CHECK(buddy.getFreeCells() == 8);
+	CHECK(reinterpret_cast<size_type>(first) % 4096 == 0);
+
+	char* second = static_cast<char*>(buddy.allocate(4096));
+	CHECK(second == first + 4096);
+	CHECK(buddy.getFreeCells() == 7);
+
+	// Freeing both merges everything back into the region.
+	buddy.deallocate(first);
+	buddy.deallocate(second);
+	CHECK(buddy.getFreeCells() == 1);
+	CHECK(buddy.getUsedCells() == 0);
+
+	std::vector<void*> blocks;
+
+	for (size_type size = 4096; size <= 1024 * 1024; size *= 2)
+	{
+		blocks.push_back(buddy.allocate(size - 100));
+		blocks.push_back(buddy.allocate(size));
+	}
+
+	CHECK(buddy.getUsedCells() == blocks.size());
+	CHECK(buddy.getChunkCount() > 1);
+
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		std::memset(blocks[i], static_cast<int>(i), 100);
+	}
+
+	for (size_t i = 0; i < blocks.size(); i += 2)
+	{
+		buddy.deallocate(blocks[i]);
+	}
+
+	for (size_t i = 1; i < blocks.size(); i += 2)
+	{
+		buddy.deallocate(blocks[i]);
+	}
+
+	// Fully free regions past the retained one went back to the OS.
+	CHECK(buddy.getUsedCells() == 0);
+	CHECK(buddy.getChunkCount() == 1);
+	CHECK(buddy.getFreeCells() == 1);
+
+	// In place resizing splits upper halves off and takes free right buddies back.
+	void* resized = buddy.allocate(64 * 1024);
+	CHECK(buddy.tryExpand(resized, 16 * 1024));
+	CHECK(buddy.getUsedAmount() == 16 * 1024);
+	CHECK(buddy.tryExpand(resized, 128 * 1024));
+	CHECK(buddy.getUsedAmount() == 128 * 1024);
+
+	void* neighbour = buddy.allocate(128 * 1024);
+	CHECK_FALSE(buddy.tryExpand(resized, 256 * 1024));
+	CHECK_FALSE(buddy.tryExpand(neighbour, 256 * 1024));
+
+	std::memset(resized, 0x3c, 128 * 1024);
+	void* moved = buddy.reallocate(resized, 256 * 1024);
+	CHECK(static_cast<unsigned char*>(moved)[128 * 1024 - 1] == 0x3c);
+
+	void* aligned = buddy.allocateAligned(100, 2048);
+	CHECK(reinterpret_cast<size_type>(aligned) % 2048 == 0);
+
+	buddy.deallocate(aligned);
+	buddy.deallocate(moved);
+	buddy.deallocate(neighbour);
+	CHECK(buddy.getFreeCells() == 1);
+	CHECK(buddy.verifyHeap());
+
+	// Untagged blocks stay with their own arena; another one leaves them alone.
+	MemoryAllocator other(AllocationEngine::Buddy);
+	void* foreign = other.allocate(4096);
+	CHECK_FALSE(buddy.tryExpand(foreign, 8192));
+	other.deallocate(foreign);
+	CHECK(buddy.verifyHeap());
+	CHECK(other.verifyHeap());
+
+	// Front ends that route frees by tag run tagged blocks instead.
+	MemoryAllocatorOptions options;
+	options.engine = AllocationEngine::Buddy;
+
+	CpuShardedAllocator sharded(2, options);
+	void* tagged = sharded.allocate(4096);
+	CHECK(MemoryAllocator::ownerOf(tagged));
+	sharded.deallocate(tagged);
+}
+
+
+TEST_CASE("Testing best-fit tree") {
+
+	MemoryAllocatorOptions options;
+	options.bestFitThreshold = 1024;
+
+	MemoryAllocator mAloc(options);
+
+	// Two large holes kept apart by used blocks, the tighter one freed first.
+	void* tight = mAloc.allocate(5000);
+	void* fence1 = mAloc.allocate(64);
+	void* loose = mAloc.allocate(8000);
+	void* fence2 = mAloc.allocate(64);
+
+	mAloc.deallocate(tight);
+	mAloc.deallocate(loose);
+	CHECK(mAloc.getFreeCells() == 3);
+
+	// The size class lists would hand out the last freed block; the tree takes the smallest that fits.
+	void* fit = mAloc.allocate(4500);
+	CHECK(fit == tight);
+	CHECK(mAloc.verifyHeap());
+
+	// Small requests still come from the lists, and fall back to the tree when those are empty.
+	void* small = mAloc.allocate(100);
+	CHECK(small);
+	CHECK(mAloc.verifyHeap());
+
+	std::vector<void*> blocks;
+
+	for (int i = 0; i < 600; i++)
+	{
+		blocks.push_back(mAloc.allocate(500 + (i * 977) % 6000));
+	}
+
+	for (size_t i = 0; i < blocks.size(); i += 3)
+	{
+		mAloc.deallocate(blocks[i]);
+	}
+
+	CHECK(mAloc.verifyHeap());
+
+	for (size_t i = 0; i < blocks.size(); i += 3)
+	{
+		blocks[i] = mAloc.allocate(1000 + (i * 613) % 4000);
+	}
+
+	CHECK(mAloc.verifyHeap());
+
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		mAloc.deallocate(blocks[i]);
+	}
+
+	mAloc.deallocate(small);
+	mAloc.deallocate(fit);
+	mAloc.deallocate(fence1);
+	mAloc.deallocate(fence2);
+
+	CHECK(mAloc.getUsedCells() == 0);
+	CHECK(mAloc.verifyHeap());
+}
+
+TEST_CASE("Testing free list policies") {
+
+	MemoryAllocatorOptions options;
+	options.freeListPolicy = FreeListPolicy::AddressOrdered;
+
+	MemoryAllocator ordered(options);
+	void* blocks[16];
+
+	for (int i = 0; i < 16; i++)
+	{
+		blocks[i] = ordered.allocate(96);
+	}
+
+	void* tail = ordered.allocate(96);
+
+	// Freed in scrambled order, every other block so none of them merge.
+	for (int i = 0; i < 16; i += 2)
+	{
+		ordered.deallocate(blocks[(i * 5) % 16]);
+	}
+
+	CHECK(ordered.verifyHeap());
+
+	// Reuse starts from the lowest address regardless of the order of the frees.
+	for (int i = 0; i < 16; i += 2)
+	{
+		CHECK(ordered.allocate(96) == blocks[i]);
+	}
+
+	options.freeListPolicy = FreeListPolicy::NextFit;
+
+	MemoryAllocator roving(options);
+
+	for (int i = 0; i < 16; i++)
+	{
+		blocks[i] = roving.allocate(96);
+	}
+
+	roving.allocate(96);
+
+	for (int i = 0; i < 16; i += 2)
+	{
+		roving.deallocate(blocks[i]);
+	}
+
+	// The list is LIFO, so the first search takes the last freed block and the next
+	// ones carry on from there instead of starting over at the head.
+	void* first = roving.allocate(96);
+	void* second = roving.allocate(96);
+	CHECK(first == blocks[14]);
+	CHECK(second == blocks[12]);
+
+	// Blocks freed since are pushed to the head, behind the rover, so they wait until
+	// the search wraps around.
+	roving.deallocate(first);
+	roving.deallocate(second);
+	CHECK(roving.allocate(80) == blocks[10]);
+	CHECK(roving.allocate(80) == blocks[8]);
+	CHECK(roving.verifyHeap());
+
+	ordered.deallocate(tail);
+	CHECK(ordered.getUsedCells() == 16);
+}
+
+TEST_CASE("Testing fast bins") {
+
+	MemoryAllocatorOptions options;
+	options.fastBinSize = 128;
+	options.fastBinLength = 8;
+
+	MemoryAllocator mAloc(options);
+
+	void* first = mAloc.allocate(40);
+	void* second = mAloc.allocate(40);
+	void* third = mAloc.allocate(40);
+
+	// Parked blocks keep their used tags, so the neighbours do not merge.
+	mAloc.deallocate(first);
+	mAloc.deallocate(second);
+	CHECK(mAloc.getUsedCells() == 1);
+	CHECK(mAloc.getFreeCells() == 3);
+	CHECK(mAloc.verifyHeap());
+
+	// Same size requests pop the bin, last freed first.
+	CHECK(mAloc.allocate(40) == second);
+	CHECK(mAloc.allocate(33) == first);
+	CHECK(mAloc.getFreeCells() == 1);
+
+	mAloc.deallocate(first);
+	mAloc.deallocate(second);
+	mAloc.deallocate(third);
+	CHECK(mAloc.getUsedCells() == 0);
+	CHECK(mAloc.getFreeCells() == 4);
+
+	mAloc.consolidateFastBins();
+	CHECK(mAloc.getFreeCells() == 1);
+	CHECK(mAloc.verifyHeap());
+
+	// A bin reaching fastBinLength is merged back on its own.
+	void* blocks[8];
+
+	for (int i = 0; i < 8; i++)
+	{
+		blocks[i] = mAloc.allocate(64);
+	}
+
+	for (int i = 0; i < 7; i++)
+	{
+		mAloc.deallocate(blocks[i]);
+	}
+
+	CHECK(mAloc.getFreeCells() == 8);
+
+	mAloc.deallocate(blocks[7]);
+	CHECK(mAloc.getFreeCells() == 1);
+	CHECK(mAloc.verifyHeap());
+
+	// Parked blocks are merged before the arena grows for a request nothing else fits.
+	MemoryAllocatorOptions bounded = options;
+	bounded.chunkSize = 4096;
+	bounded.maxArenaSize = 4096;
+
+	MemoryAllocator limited(bounded);
+	std::vector<void*> small;
+	void* block;
+
+	while ((block = limited.allocate(48)) != nullptr)
+	{
+		small.push_back(block);
+	}
+
+	for (size_t i = 0; i < small.size(); i++)
+	{
+		limited.deallocate(small[i]);
+	}
+
+	CHECK(limited.allocate(2048));
+	CHECK(limited.getChunkCount() == 1);
+	CHECK(limited.verifyHeap());
+
+	// Aligned and batch requests take parked memory back before the arena grows.
+	bounded.fastBinLength = 1000;
+
+	MemoryAllocator alignedLimit(bounded);
+	MemoryAllocator batchLimit(bounded);
+	std::vector<void*> parked;
+
+	while ((block = alignedLimit.allocate(40)) != nullptr)
+	{
+		parked.push_back(block);
+	}
+
+	for (size_t i = 0; i < parked.size(); i++)
+	{
+		alignedLimit.deallocate(parked[i]);
+	}
+
+	parked.clear();
+
+	while ((block = batchLimit.allocate(40)) != nullptr)
+	{
+		parked.push_back(block);
+	}
+
+	for (size_t i = 0; i < parked.size(); i++)
+	{
+		batchLimit.deallocate(parked[i]);
+	}
+
+	void* batch[8];
+	CHECK(alignedLimit.allocateAligned(1024, 256));
+	CHECK(alignedLimit.verifyHeap());
+	CHECK(batchLimit.allocateBatch(200, 8, batch) == 8);
+	CHECK(batchLimit.verifyHeap());
+}
+
+TEST_CASE("Testing deferred coalescing") {
+
+	MemoryAllocatorOptions options;
+	options.deferredCoalescing = true;
+	options.coalesceThreshold = 16;
+
+	MemoryAllocator mAloc(options);
+	void* blocks[10];
+
+	for (int i = 0; i < 10; i++)
+	{
+		blocks[i] = mAloc.allocate(100);
+	}
+
+	// Frees leave their neighbours alone until a pass runs.
+	for (int i = 0; i < 10; i++)
+	{
+		mAloc.deallocate(blocks[i]);
+	}
+
+	CHECK(mAloc.getUsedCells() == 0);
+	CHECK(mAloc.getFreeCells() == 11);
+	CHECK(mAloc.verifyHeap());
+
+	mAloc.coalesce();
+	CHECK(mAloc.getFreeCells() == 1);
+	CHECK(mAloc.verifyHeap());
+
+	// The threshold starts a pass on its own.
+	std::vector<void*> many;
+
+	for (int i = 0; i < 32; i++)
+	{
+		many.push_back(mAloc.allocate(64));
+	}
+
+	for (int i = 0; i < 16; i++)
+	{
+		mAloc.deallocate(many[i]);
+	}
+
+	CHECK(mAloc.getFreeCells() == 2);
+
+	for (int i = 16; i < 32; i++)
+	{
+		mAloc.deallocate(many[i]);
+	}
+
+	CHECK(mAloc.getFreeCells() == 1);
+
+	// A request no single free block fits merges the pending frees first.
+	MemoryAllocatorOptions bounded = options;
+	bounded.chunkSize = 4096;
+	bounded.maxArenaSize = 4096;
+	bounded.coalesceThreshold = 1000;
+
+	MemoryAllocator limited(bounded);
+	std::vector<void*> small;
+	void* block;
+
+	while ((block = limited.allocate(48)) != nullptr)
+	{
+		small.push_back(block);
+	}
+
+	for (size_t i = 0; i < small.size(); i++)
+	{
+		limited.deallocate(small[i]);
+	}
+
+	CHECK(limited.getFreeCells() > 1);
+	CHECK(limited.allocate(2048));
+	CHECK(limited.verifyHeap());
+
+	// Aligned and batch requests merge the pending frees too instead of failing.
+	MemoryAllocator alignedLimit(bounded);
+	MemoryAllocator batchLimit(bounded);
+	small.clear();
+
+	while ((block = alignedLimit.allocate(48)) != nullptr)
+	{
+		small.push_back(block);
+	}
+
+	for (size_t i = 0; i < small.size(); i++)
+	{
+		alignedLimit.deallocate(small[i]);
+	}
+
+	small.clear();
+
+	while ((block = batchLimit.allocate(48)) != nullptr)
+	{
+		small.push_back(block);
+	}
+
+	for (size_t i = 0; i < small.size(); i++)
+	{
+		batchLimit.deallocate(small[i]);
+	}
+
+	void* batch[8];
+	CHECK(alignedLimit.allocateAligned(1024, 256));
+	CHECK(alignedLimit.verifyHeap());
+	CHECK(batchLimit.allocateBatch(200, 8, batch) == 8);
+	CHECK(batchLimit.verifyHeap());
+
+	// Growing into a pending neighbour merges it first, so the leftover of the split does
+	// not land next to the filed wilderness.
+	MemoryAllocator growing(options);
+	growing.allocate(100);
+	void* second = growing.allocate(100);
+	growing.deallocate(growing.allocate(400));
+
+	CHECK(growing.tryExpand(second, 150));
+	CHECK(growing.verifyHeap());
+
+	// A chunk whose only block is pending is not counted as free until a pass files it.
+	// Debug builds check the heap on every call here.
+	MemoryAllocatorOptions whole = options;
+	whole.chunkSize = 4096;
+
+	MemoryAllocator emptied(whole);
+	emptied.deallocate(emptied.allocate(4040));
+	CHECK(emptied.verifyHeap());
+	emptied.coalesce();
+	CHECK(emptied.getChunkCount() == 1);
+	CHECK(emptied.verifyHeap());
+
+	// The background thread catches up without any further calls.
+	options.coalesceInterval = 1;
+
+	MemoryAllocator background(options);
+
+	for (int i = 0; i < 10; i++)
+	{
+		blocks[i] = background.allocate(100);
+	}
+
+	for (int i = 0; i < 10; i++)
+	{
+		background.deallocate(blocks[i]);
+	}
+
+	for (int i = 0; i < 1000 && background.getFreeCells() > 1; i++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	CHECK(background.getFreeCells() == 1);
+	CHECK(background.verifyHeap());
+}
+
+TEST_CASE("Testing wilderness") {
+
+	MemoryAllocatorOptions options;
+	options.chunkSize = 8192;
+
+	MemoryAllocator mAloc(options);
+
+	// Requests the lists cannot serve are cut back to back from the end of the arena.
+	char* first = static_cast<char*>(mAloc.allocate(100));
+	char* second = static_cast<char*>(mAloc.allocate(100));
+	char* third = static_cast<char*>(mAloc.allocate(100));
+	CHECK(second == first + MemoryAllocator::blockSize(100));
+	CHECK(third == second + MemoryAllocator::blockSize(100));
+
+	// A hole in the middle is reused before the wilderness.
+	mAloc.deallocate(second);
+	CHECK(mAloc.allocate(60) == second);
+
+	// Freeing the block next to the wilderness gives its space back to it.
+	mAloc.deallocate(third);
+	CHECK(mAloc.getFreeCells() == 1);
+	CHECK(mAloc.allocate(100) == third);
+	CHECK(mAloc.verifyHeap());
+
+	// A new chunk takes the wilderness over; what is left of the old one is filed in the lists.
+	void* big = mAloc.allocate(7900);
+	CHECK(mAloc.getChunkCount() == 2);
+	CHECK(mAloc.getFreeCells() == 2);
+
+	char* fourth = static_cast<char*>(mAloc.allocate(100));
+	CHECK(fourth == third + MemoryAllocator::blockSize(100));
+	CHECK(mAloc.verifyHeap());
+
+	mAloc.deallocate(big);
+	mAloc.deallocate(fourth);
+	mAloc.deallocate(third);
+	mAloc.deallocate(second);
+	mAloc.deallocate(first);
+	CHECK(mAloc.getUsedCells() == 0);
+	CHECK(mAloc.getChunkCount() == 1);
+	CHECK(mAloc.verifyHeap());
+}
+
+TEST_CASE("Testing last remainder reuse") {
+
+	MemoryAllocatorOptions options;
+	options.remainderReuseSize = 256;
+
+	MemoryAllocator mAloc(options);
+	std::vector<void*> holes;
+
+	// Holes of 1 KiB and holes that fit one node exactly, then a burst of small nodes.
+	for (int i = 0; i < 8; i++)
+	{
+		holes.push_back(mAloc.allocate(1000));
+		mAloc.allocate(16);
+		holes.push_back(mAloc.allocate(40));
+		mAloc.allocate(16);
+	}
+
+	for (size_t i = 0; i < holes.size(); i++)
+	{
+		mAloc.deallocate(holes[i]);
+	}
+
+	// The last fence was cut from the wilderness, so the burst keeps cutting what it
+	// left over instead of filling the holes.
+	char* previous = static_cast<char*>(mAloc.allocate(40));
+
+	for (int i = 0; i < 15; i++)
+	{
+		char* current = static_cast<char*>(mAloc.allocate(40));
+		CHECK(current == previous + MemoryAllocator::blockSize(40));
+		previous = current;
+	}
+
+	CHECK(mAloc.verifyHeap());
+
+	// Larger requests go to the lists and leave the remainder alone.
+	void* large = mAloc.allocate(600);
+	CHECK(large == holes[14]);
+	char* next = static_cast<char*>(mAloc.allocate(40));
+	CHECK(next == previous + MemoryAllocator::blockSize(40));
+
+	mAloc.deallocate(large);
+	CHECK(mAloc.verifyHeap());
+
+	// A pending block is never the remainder, since its neighbours may still be free.
+	options.remainderReuseSize = 48;
+	options.deferredCoalescing = true;
+
+	MemoryAllocator deferred(options);
+	void* left = deferred.allocate(56);
+	void* pending = deferred.allocate(200);
+	void* right = deferred.allocate(500);
+	deferred.allocate(56);
+
+	deferred.deallocate(left);
+	deferred.deallocate(right);
+	deferred.coalesce();
+	deferred.deallocate(pending);
+
+	CHECK(deferred.allocate(40) == left);
+	CHECK(deferred.allocate(40) != pending);
+	CHECK(deferred.verifyHeap());
+}
+
+TEST_CASE("Testing adaptive split threshold") {
+
+	MemoryAllocatorOptions options;
+	options.adaptiveSplit = true;
+
+	MemoryAllocator mAloc(options);
+	size_type initial = mAloc.getSplitThreshold();
+
+	// A service that only ever asks for 200 bytes.
+	std::vector<void*> blocks;
+
+	for (int i = 0; i < 5000; i++)
+	{
+		blocks.push_back(mAloc.allocate(200));
+	}
+
+	CHECK(mAloc.getSizeHistogram(static_cast<int>(MemoryAllocator::blockSize(200) / ALIGNMENT)) > 0);
+	CHECK(mAloc.getSplitThreshold() == MemoryAllocator::blockSize(200));
+	CHECK(mAloc.getSplitThreshold() > initial);
+	CHECK(mAloc.getSizeHistogram(-1) == 0);
+	CHECK(mAloc.getSizeHistogram(SIZE_HISTOGRAM_BINS) == 0);
+
+	// A 400 byte hole serving a 200 byte request would leave a remainder nothing asks for,
+	// so the whole hole is handed out.
+	void* hole = mAloc.allocate(400 - sizeof(info_header));
+	mAloc.allocate(16);
+	mAloc.deallocate(hole);
+
+	std::uint64_t freeCells = mAloc.getFreeCells();
+	CHECK(mAloc.allocate(200) == hole);
+	CHECK(mAloc.getFreeCells() == freeCells - 1);
+	CHECK(mAloc.usableSize(hole) == 400 - sizeof(info_header));
+
+	// The static rule splits the same hole.
+	MemoryAllocator fixed;
+	hole = fixed.allocate(400 - sizeof(info_header));
+	fixed.allocate(16);
+	fixed.deallocate(hole);
+
+	freeCells = fixed.getFreeCells();
+	CHECK(fixed.allocate(200) == hole);
+	CHECK(fixed.getFreeCells() == freeCells);
+	CHECK(fixed.getSplitThreshold() == initial);
+
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		mAloc.deallocate(blocks[i]);
+	}
+
+	CHECK(mAloc.verifyHeap());
+
+	// Tiny requests never pull the threshold below the static rule.
+	MemoryAllocator tiny(options);
+	blocks.clear();
+
+	for (int i = 0; i < 5000; i++)
+	{
+		blocks.push_back(tiny.allocate(16));
+	}
+
+	CHECK(tiny.getSplitThreshold() == initial);
+
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		tiny.deallocate(blocks[i]);
+	}
+
+	CHECK(tiny.verifyHeap());
+}
+
+// A single-threaded arena of cache-line aligned blocks without occupancy counters.
+struct CacheLineConfig
+{
+	static const size_type chunkSize = 64 * 1024;
+	static const size_type alignment = 64;
+	static const size_type splitThreshold = 40;
+	typedef TlsfSearch search_policy;
+	typedef NullLock lock_type;
+	typedef NullStats stats_policy;
+};
+
+typedef BasicMemoryAllocator<CacheLineConfig> CacheLineAllocator;
+
+TEST_CASE("Testing compile-time configurations") {
+
+	CacheLineAllocator mAloc;
+
+	CHECK(mAloc.getReservedBytes() == 64 * 1024);
+	CHECK(CacheLineAllocator::blockSize(1) == 64);
+	CHECK(sizeof(CacheLineAllocator) < sizeof(MemoryAllocator));
+
+	std::vector<void*> blocks;
+
+	for (int i = 0; i < 200; i++)
+	{
+		void* block = mAloc.allocate(1 + i * 7);
+		CHECK(reinterpret_cast<size_type>(block) % 64 == 0);
+		std::memset(block, i, 1 + i * 7);
+		blocks.push_back(block);
+	}
+
+	for (size_t i = 0; i < blocks.size(); i += 2)
+	{
+		mAloc.deallocate(blocks[i]);
+	}
+
+	CHECK(reinterpret_cast<size_type>(mAloc.allocateAligned(100, 32)) % 64 == 0);
+	CHECK(reinterpret_cast<size_type>(mAloc.allocateAligned(100, 256)) % 256 == 0);
+	CHECK(mAloc.verifyHeap());
+
+	// Nothing is counted or locked.
+	CHECK(mAloc.getFreeCells() == 0);
+	CHECK(mAloc.getUsedAmount() == 0);
+	CHECK(mAloc.getLockAcquires() == 0);
+
+	// Arenas of both configurations share the registry, so blocks still find their owner.
+	MemoryAllocator owner;
+	std::uint64_t usedCells = owner.getUsedCells();
+	void* foreign = owner.allocate(100);
+
+	CHECK(MemoryAllocator::ownerOf(foreign) == &owner);
+	CHECK(!CacheLineAllocator::ownerOf(foreign));
+	CHECK(CacheLineAllocator::ownerOf(blocks[1]) == &mAloc);
+
+	mAloc.deallocate(foreign);
+	owner.drainRemoteFrees();
+	CHECK(owner.getUsedCells() == usedCells);
+	CHECK(owner.verifyHeap());
+}